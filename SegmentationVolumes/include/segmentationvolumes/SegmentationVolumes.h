@@ -110,7 +110,7 @@ namespace raven {
 
             uint32_t m_numLights = 0;
 
-            uint32_t m_lodType = 2; // #define LOD_TYPE_SVO 0 #define LOD_TYPE_SVDAG 1 #define LOD_TYPE_SVDAG_OCCUPANCY_FIELD 2
+            uint32_t m_lodType = 2; // #define LOD_TYPE_SVO 0 #define LOD_TYPE_SVDAG 1 #define LOD_TYPE_SVDAG_OCCUPANCY_FIELD 2 #define LOD_TYPE_SVDAG_COMPACT 3 #define LOD_TYPE_SVDAG_OCCUPANCY_FIELD_COMPACT 4
 
             bool m_lod = true;
             bool m_lodDisableOnFirstFrame = true;
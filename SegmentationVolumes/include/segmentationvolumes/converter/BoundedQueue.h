@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace raven {
+    /**
+     * Blocking multi-producer multi-consumer queue with a fixed capacity that connects the stages of a pipeline.
+     * - push() blocks while the queue is full, pop() blocks while it is empty
+     * - after close(), push() discards the item and returns false, pop() drains the remaining items and then returns std::nullopt
+     * Closing the queue from any stage (e.g. on an exception) therefore unblocks all other stages.
+     */
+    template<typename T>
+    class BoundedQueue {
+    public:
+        explicit BoundedQueue(const uint32_t capacity) : m_capacity(capacity == 0 ? 1 : capacity) {}
+
+        bool push(T item) {
+            std::unique_lock lock(m_mutex);
+            m_notFull.wait(lock, [this] { return m_closed || m_items.size() < m_capacity; });
+            if (m_closed) {
+                return false;
+            }
+            m_items.push_back(std::move(item));
+            m_notEmpty.notify_one();
+            return true;
+        }
+
+        std::optional<T> pop() {
+            std::unique_lock lock(m_mutex);
+            m_notEmpty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+            if (m_items.empty()) {
+                return std::nullopt;
+            }
+            T item = std::move(m_items.front());
+            m_items.pop_front();
+            m_notFull.notify_one();
+            return item;
+        }
+
+        void close() {
+            std::lock_guard lock(m_mutex);
+            m_closed = true;
+            m_notFull.notify_all();
+            m_notEmpty.notify_all();
+        }
+
+    private:
+        uint32_t m_capacity;
+        bool m_closed = false;
+        std::deque<T> m_items;
+        std::mutex m_mutex;
+        std::condition_variable m_notFull;
+        std::condition_variable m_notEmpty;
+    };
+} // namespace raven
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace raven {
+    /**
+     * Maps the ids of a raw segmentation volume to 32bit labels with a two-level paged table instead of hash maps.
+     * The upper 16 bits of an id select a page of 2^16 labels, pages without any mapped id share a single page of UNMAPPED entries,
+     * hence a lookup is two dependent loads without branches and the table only grows with the number of occupied pages.
+     * Ids are unsigned integers of 8, 16, 32 or 64 bits (see dispatchIdType), the few mapped ids beyond 32 bits are kept in a hash map.
+     * scanRow() resolves a row of ids run by run: runs of equal ids (e.g. the background) are skipped with one comparison per 32 bytes (AVX2) and looked up once.
+     */
+    class LabelRemap {
+    public:
+        static constexpr uint32_t UNMAPPED = UINT32_MAX;
+
+        LabelRemap() : m_pages(NUM_PAGES, unmappedPage().data()) {}
+
+        // id -> label
+        explicit LabelRemap(const std::unordered_map<uint64_t, uint32_t> &map) : LabelRemap() {
+            for (const auto &[id, label]: map) {
+                set(id, label);
+            }
+        }
+
+        // id -> first[id] -> second[first[id]], ids that are not mapped by both maps stay unmapped
+        static LabelRemap compose(const std::unordered_map<uint64_t, uint32_t> &first, const std::unordered_map<uint32_t, uint32_t> &second) {
+            LabelRemap remap;
+            for (const auto &[id, intermediate]: first) {
+                if (const auto label = second.find(intermediate); label != second.end()) {
+                    remap.set(id, label->second);
+                }
+            }
+            return remap;
+        }
+
+        void set(const uint64_t id, const uint32_t label) {
+            if (label == UNMAPPED) {
+                throw std::runtime_error("LabelRemap: Label " + std::to_string(label) + " is reserved.");
+            }
+            if (id > UINT32_MAX) {
+                m_wideIds[id] = label;
+                return;
+            }
+            auto &page = m_ownedPages[id >> PAGE_BITS];
+            if (!page) {
+                page = std::make_unique<Page>(unmappedPage());
+                m_pages[id >> PAGE_BITS] = page->data();
+            }
+            (*page)[id & PAGE_MASK] = label;
+        }
+
+        template<typename Id>
+        [[nodiscard]] uint32_t operator[](const Id id) const {
+            static_assert(std::is_unsigned_v<Id>);
+            if constexpr (sizeof(Id) > sizeof(uint32_t)) {
+                if (id > UINT32_MAX) {
+                    const auto label = m_wideIds.find(id);
+                    return label == m_wideIds.end() ? UNMAPPED : label->second;
+                }
+            }
+            const auto narrowId = static_cast<uint32_t>(id);
+            return m_pages[narrowId >> PAGE_BITS][narrowId & PAGE_MASK];
+        }
+
+        /**
+         * Calls kernel(std::type_identity<Id>{}) with the unsigned id type of the given width in bytes, i.e. the extraction kernel is instantiated for every id type
+         * and the ids are processed in their stored width.
+         */
+        template<typename Kernel>
+        static void dispatchIdType(const size_t bytes, Kernel kernel) {
+            switch (bytes) {
+                case sizeof(uint8_t):
+                    kernel(std::type_identity<uint8_t>{});
+                    return;
+                case sizeof(uint16_t):
+                    kernel(std::type_identity<uint16_t>{});
+                    return;
+                case sizeof(uint32_t):
+                    kernel(std::type_identity<uint32_t>{});
+                    return;
+                case sizeof(uint64_t):
+                    kernel(std::type_identity<uint64_t>{});
+                    return;
+                default:
+                    throw std::runtime_error("LabelRemap: Unsupported id width of " + std::to_string(bytes) + " bytes.");
+            }
+        }
+
+        /**
+         * Calls emit(label, id, begin, end) for every run [begin, end) of equal, mapped ids of the row.
+         */
+        template<typename Id, typename Emit>
+        void scanRow(const Id *row, const uint32_t length, Emit emit) const {
+            for (uint32_t x = 0; x < length;) {
+                const uint32_t end = runEnd(row, x, length);
+                if (const uint32_t label = (*this)[row[x]]; label != UNMAPPED) {
+                    emit(label, row[x], x, end);
+                }
+                x = end;
+            }
+        }
+
+        // end of the run of ids equal to row[begin]
+        template<typename Id>
+        static uint32_t runEnd(const Id *row, const uint32_t begin, const uint32_t length) {
+            const Id id = row[begin];
+            uint32_t x = begin + 1;
+#ifdef __AVX2__
+            constexpr uint32_t lanes = sizeof(__m256i) / sizeof(Id);
+            const __m256i ids = broadcast(id);
+            for (; x + lanes <= length; x += lanes) {
+                // one mask bit per byte, sizeof(Id) bits per id
+                const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(equal<Id>(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + x)), ids)));
+                if (mask != UINT32_MAX) {
+                    return x + std::countr_one(mask) / sizeof(Id);
+                }
+            }
+#endif
+            while (x < length && row[x] == id) {
+                x++;
+            }
+            return x;
+        }
+
+    private:
+        static constexpr uint32_t PAGE_BITS = 16;
+        static constexpr uint32_t NUM_PAGES = 1u << (32 - PAGE_BITS);
+        static constexpr uint32_t PAGE_MASK = (1u << PAGE_BITS) - 1;
+        typedef std::array<uint32_t, 1u << PAGE_BITS> Page;
+
+        std::vector<const uint32_t *> m_pages;                          // page of every id >> PAGE_BITS, unmappedPage() if not owned
+        std::unordered_map<uint32_t, std::unique_ptr<Page>> m_ownedPages; // pages with at least one mapped id
+        std::unordered_map<uint64_t, uint32_t> m_wideIds;                  // mapped ids > UINT32_MAX
+
+        static const Page &unmappedPage() {
+            static const Page page = [] {
+                Page p;
+                p.fill(UNMAPPED);
+                return p;
+            }();
+            return page;
+        }
+
+#ifdef __AVX2__
+        template<typename Id>
+        static __m256i broadcast(const Id id) {
+            if constexpr (sizeof(Id) == 1) {
+                return _mm256_set1_epi8(static_cast<char>(id));
+            } else if constexpr (sizeof(Id) == 2) {
+                return _mm256_set1_epi16(static_cast<int16_t>(id));
+            } else if constexpr (sizeof(Id) == 4) {
+                return _mm256_set1_epi32(static_cast<int32_t>(id));
+            } else {
+                return _mm256_set1_epi64x(static_cast<int64_t>(id));
+            }
+        }
+
+        template<typename Id>
+        static __m256i equal(const __m256i a, const __m256i b) {
+            if constexpr (sizeof(Id) == 1) {
+                return _mm256_cmpeq_epi8(a, b);
+            } else if constexpr (sizeof(Id) == 2) {
+                return _mm256_cmpeq_epi16(a, b);
+            } else if constexpr (sizeof(Id) == 4) {
+                return _mm256_cmpeq_epi32(a, b);
+            } else {
+                return _mm256_cmpeq_epi64(a, b);
+            }
+        }
+#endif
+    };
+} // namespace raven
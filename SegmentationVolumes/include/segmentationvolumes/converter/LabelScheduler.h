@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace raven {
+    /**
+     * Processes independent per-label jobs concurrently on a fixed number of worker threads.
+     * - jobs are started largest footprint first, such that a single large label does not become the tail of the schedule
+     * - the summed footprint of all in-flight jobs stays below the memory budget, smaller jobs are allowed to fill up the remaining budget
+     *   while a large job is waiting, a job larger than the whole budget is started as soon as no other job is in flight
+     * - log() and recordTiming() may be called from within the jobs
+     */
+    class LabelScheduler {
+    public:
+        struct Job {
+            std::string m_name;
+            uint64_t m_footprint;                       // estimated peak memory of the job in bytes
+            std::function<void(uint32_t worker)> m_work; // worker \in [0, numThreads - 1]
+        };
+
+        LabelScheduler(const uint32_t numThreads, const uint64_t memoryBudget) : m_numThreads(std::max(1u, numThreads)), m_memoryBudget(memoryBudget) {}
+
+        void run(std::vector<Job> jobs) {
+            std::stable_sort(jobs.begin(), jobs.end(), [](const Job &a, const Job &b) { return a.m_footprint > b.m_footprint; });
+
+            m_pending = std::move(jobs);
+            m_started.assign(m_pending.size(), false);
+            m_numStarted = 0;
+            m_inFlightFootprint = 0;
+            m_inFlightJobs = 0;
+            m_exception = nullptr;
+
+            const uint32_t numWorkers = std::min(m_numThreads, static_cast<uint32_t>(m_pending.size()));
+            std::vector<std::thread> workers;
+            workers.reserve(numWorkers);
+            for (uint32_t worker = 0; worker < numWorkers; worker++) {
+                workers.emplace_back([this, worker] { workerLoop(worker); });
+            }
+            for (auto &worker: workers) {
+                worker.join();
+            }
+
+            m_pending.clear();
+
+            if (m_exception) {
+                std::rethrow_exception(m_exception);
+            }
+        }
+
+        void log(const std::string &message) {
+            std::lock_guard lock(m_logMutex);
+            std::cout << message << std::endl;
+        }
+
+        void recordTiming(const std::string &name, const double ms) {
+            std::lock_guard lock(m_logMutex);
+            m_timings.emplace_back(name, ms);
+            m_totalTime += ms;
+        }
+
+        void printTimings(const std::string &tag) {
+            std::lock_guard lock(m_logMutex);
+            std::sort(m_timings.begin(), m_timings.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+            for (const auto &[name, ms]: m_timings) {
+                std::cout << "[" << tag << "] " << name << ": " << ms << "[ms]" << std::endl;
+            }
+            std::cout << "[" << tag << "] Total time: " << m_totalTime << "[ms]" << std::endl;
+        }
+
+        [[nodiscard]] double getTotalTime() {
+            std::lock_guard lock(m_logMutex);
+            return m_totalTime;
+        }
+
+    private:
+        uint32_t m_numThreads;
+        uint64_t m_memoryBudget;
+
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        std::vector<Job> m_pending;
+        std::vector<bool> m_started;
+        size_t m_numStarted = 0;
+        uint64_t m_inFlightFootprint = 0;
+        uint32_t m_inFlightJobs = 0;
+        std::exception_ptr m_exception;
+
+        std::mutex m_logMutex;
+        std::vector<std::pair<std::string, double>> m_timings;
+        double m_totalTime = 0;
+
+        void workerLoop(const uint32_t worker) {
+            while (true) {
+                size_t jobIndex;
+                {
+                    std::unique_lock lock(m_mutex);
+                    bool found = false;
+                    m_condition.wait(lock, [this, &jobIndex, &found] {
+                        if (m_numStarted == m_pending.size() || m_exception) {
+                            return true;
+                        }
+                        found = nextJob(&jobIndex);
+                        return found;
+                    });
+                    if (!found) {
+                        return;
+                    }
+                    m_started[jobIndex] = true;
+                    m_numStarted++;
+                    m_inFlightFootprint += m_pending[jobIndex].m_footprint;
+                    m_inFlightJobs++;
+                }
+
+                try {
+                    m_pending[jobIndex].m_work(worker);
+                } catch (...) {
+                    std::lock_guard lock(m_mutex);
+                    if (!m_exception) {
+                        m_exception = std::current_exception();
+                    }
+                }
+
+                {
+                    std::lock_guard lock(m_mutex);
+                    m_inFlightFootprint -= m_pending[jobIndex].m_footprint;
+                    m_inFlightJobs--;
+                }
+                m_condition.notify_all();
+            }
+        }
+
+        // pending jobs are sorted by footprint, pick the largest one that fits into the remaining budget
+        bool nextJob(size_t *jobIndex) const {
+            for (size_t i = 0; i < m_pending.size(); i++) {
+                if (m_started[i]) {
+                    continue;
+                }
+                if (m_inFlightJobs == 0 || m_inFlightFootprint + m_pending[i].m_footprint <= m_memoryBudget) {
+                    *jobIndex = i;
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+} // namespace raven
@@ -1,87 +1,238 @@
 #pragma once
 
+#include "BoundedQueue.h"
+#include "LabelRemap.h"
 #include "SegmentationVolumeConverter.h"
 #include "highfive/highfive.hpp"
 
+#include <mutex>
+#include <thread>
+
 namespace raven {
     class MouseConverter final : public SegmentationVolumeConverter {
     public:
         MouseConverter(std::string data, std::string scene, const bool svdagOccupancyField) : SegmentationVolumeConverter("neuron", "neurons", std::move(data), std::move(scene), svdagOccupancyField) {}
 
+        /**
+         * The cubes are converted by a pipeline of three stages that overlap:
+         * - a reader thread reads the cubes slab by slab as hyperslabs through HighFive (HDF5 is not thread-safe), see readCube
+         * - m_numThreads scan threads extract the voxels of a slab and turn them into bricks
+         * - the VoxelWriter buffers the bricks per label and writes them in batches on its flusher thread
+         * The reader and the scanners are connected by a bounded queue, at most 2 * m_numThreads + 1 slabs (queued, scanning, reading) are in memory instead of whole cubes.
+         * The pipeline is instantiated for the id type of the cubes (uint8, uint16, uint32 or uint64), the slabs keep the ids in their stored width.
+         */
         void rawDataToVoxelTypes() override {
             createVoxelDirectories();
 
             // load mapping
-            std::unordered_map<uint32_t, uint32_t> mappedSegmentIdToAgglomerateId; // mappedSegmentId -> agglomerateId
+            std::unordered_map<uint64_t, uint32_t> mappedSegmentIdToAgglomerateId; // mappedSegmentId (may exceed 32 bits) -> agglomerateId
             std::unordered_map<uint32_t, uint32_t> agglomerateIdToNeuronId;        // agglomerateId -> neuronId
             loadMouseCortexDendrites(m_data + "/" + m_scene + "/dendrites.hdf5", mappedSegmentIdToAgglomerateId, agglomerateIdToNeuronId);
+            const LabelRemap remap = LabelRemap::compose(mappedSegmentIdToAgglomerateId, agglomerateIdToNeuronId); // mappedSegmentId -> neuronId
 
-            uint32_t types = 0;
+            // all cubes share the id type of the first one
+            size_t idBytes = sizeof(uint32_t);
             for (const auto &entry: std::filesystem::directory_iterator(m_data + "/" + m_scene)) {
-                // volume path
-                const std::regex rgx("x([0-9]+)y([0-9]+)z([0-9]+)\\.hdf5");
-                const std::string filename = entry.path().filename().string();
-                std::smatch matches;
-                std::regex_search(filename, matches, rgx);
-                if (matches.size() != 4) {
-                    continue;
+                if (glm::ivec3 coordinate; cubeCoordinate(entry, coordinate)) {
+                    HighFive::File file(entry.path(), HighFive::File::ReadOnly);
+                    idBytes = datasetIdBytes(file.getDataSet(file.getObjectName(0)));
+                    break;
                 }
-                auto coordinate = glm::ivec3(std::stoi(matches[1]), std::stoi(matches[2]), std::stoi(matches[3]));
-                const auto offset = glm::ivec3(1024) * coordinate;
-                std::cout << "[" << filename << "]" << std::endl;
-
-                // load volume
-                HighFive::File file(entry.path(), HighFive::File::ReadOnly);
-                auto dataset = file.getDataSet(file.getObjectName(0));
-                std::cout << "[" << filename << "] Volume loaded." << std::endl;
+            }
+            LabelRemap::dispatchIdType(idBytes, [this, &remap](const auto idType) {
+                convertCubes<typename decltype(idType)::type>(remap);
+            });
+        }
 
-                // read dimension
-                std::vector<size_t> dimensions = dataset.getDimensions();
-                auto max_dim = static_cast<float>(std::max(dimensions.at(0), std::max(dimensions.at(1), dimensions.at(2))));
-                float physical_size_x = static_cast<float>(dimensions.at(0)) / max_dim;
-                float physical_size_y = static_cast<float>(dimensions.at(1)) / max_dim;
-                float physical_size_z = static_cast<float>(dimensions.at(2)) / max_dim;
-                if (physical_size_x <= 0.f || physical_size_y <= 0.f || physical_size_z <= 0.f || !std::isfinite(physical_size_x) || !std::isfinite(physical_size_y) || !std::isfinite(physical_size_z)) {
-                    throw std::invalid_argument("invalid hdf5 physical volume size");
-                }
+    private:
+        static constexpr uint32_t BRICK_EXTENT = 16;
 
-                // allocate a memory region and read hdf5 object to it
-                auto payload = std::vector<uint32_t>(dimensions[0] * dimensions[1] * dimensions[2]);
-                dataset.read_raw<uint32_t>(payload.data());
+        template<typename Id>
+        struct Slab {
+            std::string filename;
+            uint32_t numSlabs;     // of the cube
+            glm::ivec3 offset;     // of the first voxel of the slab
+            glm::ivec3 dimensions; // x: dataset dimension 2, y: dataset dimension 1, z: slab depth along dataset dimension 0
+            std::vector<Id> payload;
+        };
 
-                // extract voxels
-                std::map<uint32_t, std::vector<glm::ivec3>> voxels;
+        template<typename Id>
+        void convertCubes(const LabelRemap &remap) const {
+            BoundedQueue<Slab<Id>> slabs(m_numThreads);
+            VoxelWriter writer = createVoxelWriter();
+            std::exception_ptr exception;
+            std::mutex exceptionMutex;
+            const auto fail = [&] {
+                {
+                    std::lock_guard lock(exceptionMutex);
+                    if (!exception) {
+                        exception = std::current_exception();
+                    }
+                }
+                slabs.close();
+            };
 
-                for (int32_t vz = 0; vz < dimensions[2]; vz++) {
-                    for (int32_t vy = 0; vy < dimensions[1]; vy++) {
-                        for (int32_t vx = 0; vx < dimensions[0]; vx++) {
-                            const uint32_t mappedSegmentId = payload[vz * dimensions[0] * dimensions[1] + vy * dimensions[0] + vx];
+            std::thread reader([&] {
+                try {
+                    for (const auto &entry: std::filesystem::directory_iterator(m_data + "/" + m_scene)) {
+                        if (!readCube<Id>(entry, slabs)) {
+                            break;
+                        }
+                    }
+                } catch (...) {
+                    fail();
+                }
+                slabs.close();
+            });
 
-                            const auto agglomerateId = mappedSegmentIdToAgglomerateId.find(mappedSegmentId);
-                            if (agglomerateId == mappedSegmentIdToAgglomerateId.end()) {
-                                continue;
-                            }
+            std::unordered_map<std::string, uint32_t> cubeSlabs; // number of extracted slabs per cube
+            uint32_t cubes = 0;
+            std::mutex progressMutex;
+            std::vector<std::thread> scanners;
+            for (uint32_t i = 0; i < m_numThreads; i++) {
+                scanners.emplace_back([&] {
+                    try {
+                        while (auto slab = slabs.pop()) {
+                            std::map<uint32_t, std::vector<VoxelBricks::Brick>> bricks; // neuronId -> bricks
+                            extractSlabBricks(*slab, remap, bricks);
+                            const std::string filename = std::move(slab->filename);
+                            const uint32_t numSlabs = slab->numSlabs;
+                            slab.reset(); // release the payload before waiting for the writer
+                            writer.write(std::move(bricks));
 
-                            const auto typeId = agglomerateIdToNeuronId.find(agglomerateId->second);
-                            if (typeId == agglomerateIdToNeuronId.end()) {
-                                continue;
+                            std::lock_guard lock(progressMutex);
+                            if (++cubeSlabs[filename] == numSlabs) {
+                                std::cout << "[" << filename << "] Voxels extracted." << std::endl;
+                                std::cout << "Processed " << ++cubes << "." << std::endl;
                             }
-
-                            insertVoxel(voxels, typeId->second, offset, vx, vy, vz);
                         }
+                    } catch (...) {
+                        fail();
                     }
+                });
+            }
+
+            reader.join();
+            for (auto &scanner: scanners) {
+                scanner.join();
+            }
+            if (exception) {
+                std::rethrow_exception(exception);
+            }
+            writer.close();
+        }
+
+        /**
+         * Reads the cube if entry is a x*y*z*.hdf5 file and pushes it slab by slab, returns false if the queue has been closed.
+         * A slab is a hyperslab of whole slices along the slowest dataset dimension, its depth is the chunk extent of the dataset along this dimension rounded up to a multiple of 16,
+         * such that every chunk is decoded once and the slabs consist of whole bricks (the cube offsets are multiples of 16).
+         */
+        template<typename Id>
+        static bool readCube(const std::filesystem::directory_entry &entry, BoundedQueue<Slab<Id>> &outSlabs) {
+            glm::ivec3 coordinate;
+            if (!cubeCoordinate(entry, coordinate)) {
+                return true;
+            }
+            const std::string filename = entry.path().filename().string();
+            const auto offset = glm::ivec3(1024) * coordinate;
+            std::cout << "[" << filename << "]" << std::endl;
+
+            // load volume
+            HighFive::File file(entry.path(), HighFive::File::ReadOnly);
+            auto dataset = file.getDataSet(file.getObjectName(0));
+            if (datasetIdBytes(dataset) != sizeof(Id)) {
+                throw std::runtime_error("[" + filename + "] The ids are " + std::to_string(datasetIdBytes(dataset)) + " bytes wide, the previous cubes have " + std::to_string(sizeof(Id)) + " byte ids.");
+            }
+
+            // read dimension
+            const std::vector<size_t> dimensions = dataset.getDimensions();
+            auto max_dim = static_cast<float>(std::max(dimensions.at(0), std::max(dimensions.at(1), dimensions.at(2))));
+            float physical_size_x = static_cast<float>(dimensions.at(0)) / max_dim;
+            float physical_size_y = static_cast<float>(dimensions.at(1)) / max_dim;
+            float physical_size_z = static_cast<float>(dimensions.at(2)) / max_dim;
+            if (physical_size_x <= 0.f || physical_size_y <= 0.f || physical_size_z <= 0.f || !std::isfinite(physical_size_x) || !std::isfinite(physical_size_y) || !std::isfinite(physical_size_z)) {
+                throw std::invalid_argument("invalid hdf5 physical volume size");
+            }
+
+            size_t depth = BRICK_EXTENT;
+            try {
+                const std::vector<hsize_t> chunk = HighFive::Chunking(dataset.getCreatePropertyList()).getDimensions();
+                depth = (std::max<size_t>(chunk.at(0), 1) + BRICK_EXTENT - 1) / BRICK_EXTENT * BRICK_EXTENT;
+            } catch (const HighFive::Exception &) {
+                // contiguous layout
+            }
+            const auto numSlabs = static_cast<uint32_t>((dimensions[0] + depth - 1) / depth);
+
+            // read hyperslabs
+            for (size_t z0 = 0; z0 < dimensions[0]; z0 += depth) {
+                Slab<Id> slab;
+                slab.filename = filename;
+                slab.numSlabs = numSlabs;
+                slab.offset = offset + glm::ivec3(0, 0, static_cast<int32_t>(z0));
+                slab.dimensions = glm::ivec3(static_cast<int32_t>(dimensions[2]), static_cast<int32_t>(dimensions[1]), static_cast<int32_t>(std::min(depth, dimensions[0] - z0)));
+                slab.payload.resize(static_cast<size_t>(slab.dimensions.x) * slab.dimensions.y * slab.dimensions.z);
+                dataset.select({z0, 0, 0}, {static_cast<size_t>(slab.dimensions.z), dimensions[1], dimensions[2]}).read_raw<Id>(slab.payload.data());
+                if (!outSlabs.push(std::move(slab))) {
+                    return false;
                 }
+            }
+            std::cout << "[" << filename << "] Volume loaded (" << numSlabs << " slabs)." << std::endl;
+            return true;
+        }
 
-                std::cout << "[" << filename << "] Voxels extracted." << std::endl;
+        // the coordinate of the cube if entry is a x*y*z*.hdf5 file
+        static bool cubeCoordinate(const std::filesystem::directory_entry &entry, glm::ivec3 &outCoordinate) {
+            const std::regex rgx("x([0-9]+)y([0-9]+)z([0-9]+)\\.hdf5");
+            const std::string filename = entry.path().filename().string();
+            std::smatch matches;
+            std::regex_search(filename, matches, rgx);
+            if (matches.size() != 4) {
+                return false;
+            }
+            outCoordinate = glm::ivec3(std::stoi(matches[1]), std::stoi(matches[2]), std::stoi(matches[3]));
+            return true;
+        }
 
-                writeVoxels(voxels);
+        // width of the unsigned integer ids of the dataset in bytes
+        static size_t datasetIdBytes(const HighFive::DataSet &dataset) {
+            const HighFive::DataType type = dataset.getDataType();
+            if (type == HighFive::create_datatype<uint8_t>()) {
+                return sizeof(uint8_t);
+            }
+            if (type == HighFive::create_datatype<uint16_t>()) {
+                return sizeof(uint16_t);
+            }
+            if (type == HighFive::create_datatype<uint32_t>()) {
+                return sizeof(uint32_t);
+            }
+            if (type == HighFive::create_datatype<uint64_t>()) {
+                return sizeof(uint64_t);
+            }
+            throw std::runtime_error("Unsupported data type " + type.string() + ", the ids have to be unsigned integers of 8, 16, 32 or 64 bits.");
+        }
+
+        template<typename Id>
+        static void extractSlabBricks(const Slab<Id> &slab, const LabelRemap &remap, std::map<uint32_t, std::vector<VoxelBricks::Brick>> &outBricks) {
+            std::map<uint32_t, std::vector<glm::ivec3>> voxels;
 
-                std::cout << "Processed " << ++types << "." << std::endl;
+            for (int32_t vz = 0; vz < slab.dimensions.z; vz++) {
+                for (int32_t vy = 0; vy < slab.dimensions.y; vy++) {
+                    const Id *row = slab.payload.data() + (static_cast<uint64_t>(vz) * slab.dimensions.y + vy) * slab.dimensions.x;
+                    remap.scanRow(row, slab.dimensions.x, [&voxels, &slab, vy, vz](const uint32_t typeId, Id, const uint32_t begin, const uint32_t end) {
+                        auto &typeVoxels = voxels[typeId];
+                        for (uint32_t vx = begin; vx < end; vx++) {
+                            typeVoxels.emplace_back(slab.offset.x + static_cast<int32_t>(vx), slab.offset.y + vy, slab.offset.z + vz);
+                        }
+                    });
+                }
+            }
+
+            for (const auto &[typeId, typeVoxels]: voxels) {
+                outBricks[typeId] = VoxelBricks::build(std::span<const glm::ivec3>(typeVoxels));
             }
         }
 
-    private:
-        static void loadMouseCortexDendrites(const std::string &url, std::unordered_map<uint32_t, uint32_t> &mappedSegmentIdToAgglomerateId, std::unordered_map<uint32_t, uint32_t> &agglomerateIdToNeuronId) {
+        static void loadMouseCortexDendrites(const std::string &url, std::unordered_map<uint64_t, uint32_t> &mappedSegmentIdToAgglomerateId, std::unordered_map<uint32_t, uint32_t> &agglomerateIdToNeuronId) {
             // "The dendrite reconstructions are stored in dendrites.hdf5. Here, "dendrites" refers to all postsynaptic targets (including, for example, neuronal somata)." from
             // https://l4dense2019.brain.mpg.de/#neurite-sec For all biology laymen (as myself): https://en.wikipedia.org/wiki/Soma_(biology) (the first image "structure of a typical neuron" is very helpful)
 
@@ -96,7 +247,11 @@ namespace raven {
                 const std::vector<size_t> dimensions = dataset.getDimensions();
                 assert(dimensions.size() == 1 && "dataset contains more than one dimension");
                 // allocate a memory region and read hdf5 object to it
-                const auto payload = dataset.read<std::vector<uint32_t>>();
+                // segment ids are read in 64 bits, the agglomerate ids are the dense indices of the dataset
+                const auto payload = dataset.read<std::vector<uint64_t>>();
+                if (payload.size() > UINT32_MAX) {
+                    throw std::runtime_error("Number of agglomerates exceeds 32 bits.");
+                }
                 for (uint32_t i = 0; i < payload.size(); i++) {
                     if (payload[i] != 0) {
                         mappedSegmentIdToAgglomerateId[payload[i]] = i;
@@ -111,10 +266,16 @@ namespace raven {
                 const std::vector<size_t> dimensions = dataset.getDimensions();
                 assert(dimensions.size() == 1 && "dataset contains more than one dimension");
                 // allocate a memory region and read hdf5 object to it
-                const auto payload = dataset.read<std::vector<uint32_t>>();
+                const auto payload = dataset.read<std::vector<uint64_t>>();
+                if (payload.size() > UINT32_MAX) {
+                    throw std::runtime_error("Number of agglomerates exceeds 32 bits.");
+                }
                 for (uint32_t i = 0; i < payload.size(); i++) {
+                    if (payload[i] >= LabelRemap::UNMAPPED) {
+                        throw std::runtime_error("Neuron id " + std::to_string(payload[i]) + " exceeds the 32 bit labels.");
+                    }
                     if (payload[i] != 0) {
-                        agglomerateIdToNeuronId[i] = payload[i];
+                        agglomerateIdToNeuronId[i] = static_cast<uint32_t>(payload[i]);
                     }
                 }
             }
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <future>
+#include <map>
 #include <utility>
 
+#include "LabelRemap.h"
 #include "SegmentationVolumeConverter.h"
 
 namespace raven {
@@ -13,97 +16,62 @@ namespace raven {
             createVoxelDirectories();
 
             // load mapping
-            std::unordered_map<uint32_t, uint32_t> cellIdToTypeId; // cellId -> typeId
+            std::unordered_map<uint64_t, uint32_t> cellIdToTypeId; // cellId -> typeId, cell ids may exceed 32 bits
             loadTypes(m_data + "/" + m_scene + "/cells.csv", cellIdToTypeId);
+            LabelRemap remap;
+            for (const auto &[cellId, typeId]: cellIdToTypeId) {
+                if (!excludeType(typeId)) {
+                    remap.set(cellId, typeId);
+                }
+            }
 
             // volume path
             const std::string filename = m_data + "/" + m_scene + "/cells.raw";
             std::cout << "[" << filename << "]" << std::endl;
 
-            // load volume
-            std::vector<uint32_t> payload;
-            glm::ivec3 dimensions;
-            {
-                std::ifstream nrrd(filename, std::ios_base::in | std::ios_base::binary);
-                if (!nrrd.is_open()) {
-                    std::ostringstream err;
-                    err << "Unable to open cellsinsilico NRRD file at: " << filename << std::endl;
-                    throw std::runtime_error(err.str());
-                }
-
-                // read header
-                std::string line;
-                // first line contains space seperated width height depth
-                if (!std::getline(nrrd, line)) {
-                    nrrd.close();
-                    throw std::runtime_error("Unexpected end of file in: " + filename);
-                }
-                std::istringstream sizes(line);
-                sizes >> dimensions[0] >> dimensions[1] >> dimensions[2];
-                // second line contains data type
-                if (!std::getline(nrrd, line)) {
-                    nrrd.close();
-                    throw std::runtime_error("Unexpected end of file in: " + filename);
-                }
-                if (line != "uint32") {
-                    nrrd.close();
-                    throw std::runtime_error("Data type " + line + " does not equal to requested format uint32.");
-                }
-                constexpr uint16_t bits_per_sample = 32;
-
-                const auto max_dim = static_cast<float>(std::max(dimensions[0], std::max(dimensions[1], dimensions[2])));
-                const auto physical_size_x = static_cast<float>(dimensions[0]) / max_dim;
-                const auto physical_size_y = static_cast<float>(dimensions[1]) / max_dim;
-                const auto physical_size_z = static_cast<float>(dimensions[2]) / max_dim;
-
-                if (physical_size_x <= 0.f || physical_size_y <= 0.f || physical_size_z <= 0.f || !std::isfinite(physical_size_x) || !std::isfinite(physical_size_y) || !std::isfinite(physical_size_z)) {
-                    nrrd.close();
-                    throw std::invalid_argument("Invalid NRRD physical volume size.");
-                }
-
-                // thats a 8GiB volume for 8bit samples, 16GiB for 16bit samples
-                const std::streamsize voxel_count = dimensions[0] * dimensions[1] * dimensions[2];
-
-                std::streamsize byte_size = voxel_count * (bits_per_sample / 8);
-                payload.resize(voxel_count);
-
-                // read binary data inline
-                nrrd.read(reinterpret_cast<char *>(payload.data()), byte_size);
-
-                if (!nrrd) {
-                    nrrd.close();
-                    throw std::runtime_error("Only " + std::to_string(nrrd.gcount()) + " bytes of expected " + std::to_string(byte_size) + " bytes could be read from NRRD file.");
-                }
-
-                nrrd.close();
+            // read header
+            std::ifstream nrrd(filename, std::ios_base::in | std::ios_base::binary);
+            if (!nrrd.is_open()) {
+                std::ostringstream err;
+                err << "Unable to open cellsinsilico NRRD file at: " << filename << std::endl;
+                throw std::runtime_error(err.str());
             }
-            std::cout << "[" << filename << "] Volume loaded." << std::endl;
-
-            // extract voxels
-            // std::map<uint32_t, std::vector<glm::ivec3>> voxels;
-            std::map<uint32_t, std::vector<glm::ivec4>> voxels;
 
-            for (int32_t vz = 0; vz < dimensions[2]; vz++) {
-                for (int32_t vy = 0; vy < dimensions[1]; vy++) {
-                    for (int32_t vx = 0; vx < dimensions[0]; vx++) {
-                        const uint32_t cellId = payload[vz * dimensions[0] * dimensions[1] + vy * dimensions[0] + vx];
+            glm::ivec3 dimensions;
+            std::string line;
+            // first line contains space seperated width height depth
+            if (!std::getline(nrrd, line)) {
+                throw std::runtime_error("Unexpected end of file in: " + filename);
+            }
+            std::istringstream sizes(line);
+            sizes >> dimensions[0] >> dimensions[1] >> dimensions[2];
+            // second line contains data type
+            if (!std::getline(nrrd, line)) {
+                throw std::runtime_error("Unexpected end of file in: " + filename);
+            }
+            const size_t idBytes = line == "uint8" ? 1 : line == "uint16" ? 2 : line == "uint32" ? 4 : line == "uint64" ? 8 : 0;
+            if (idBytes == 0) {
+                throw std::runtime_error("Data type " + line + " is not one of the supported formats uint8, uint16, uint32 and uint64.");
+            }
 
-                        const auto typeId = cellIdToTypeId.find(cellId);
-                        if (typeId == cellIdToTypeId.end()) {
-                            continue;
-                        }
-                        if (excludeType(typeId->second)) {
-                            continue;
-                        }
+            const auto max_dim = static_cast<float>(std::max(dimensions[0], std::max(dimensions[1], dimensions[2])));
+            const auto physical_size_x = static_cast<float>(dimensions[0]) / max_dim;
+            const auto physical_size_y = static_cast<float>(dimensions[1]) / max_dim;
+            const auto physical_size_z = static_cast<float>(dimensions[2]) / max_dim;
 
-                        insertVoxel(voxels, typeId->second, glm::ivec3(0), vx, vy, vz, cellId); // use cellId for subdivision
-                    }
-                }
+            if (physical_size_x <= 0.f || physical_size_y <= 0.f || physical_size_z <= 0.f || !std::isfinite(physical_size_x) || !std::isfinite(physical_size_y) || !std::isfinite(physical_size_z)) {
+                throw std::invalid_argument("Invalid NRRD physical volume size.");
             }
 
-            std::cout << "[" << filename << "] Voxels extracted." << std::endl;
+            const std::streamoff payloadOffset = nrrd.tellg();
+            std::map<uint32_t, uint64_t> numVoxels;
+            LabelRemap::dispatchIdType(idBytes, [&](const auto idType) {
+                extractVolume<typename decltype(idType)::type>(nrrd, filename, payloadOffset, dimensions, remap, numVoxels);
+            });
 
-            writeVoxels(voxels);
+            for (const auto &[typeId, count]: numVoxels) {
+                std::cout << m_prefix << typeId << " has " << count << " voxels." << std::endl;
+            }
         }
 
     protected:
@@ -111,47 +79,24 @@ namespace raven {
         uint32_t m_csvLineSkipFields{};
         std::vector<uint32_t> m_excludedTypes{};
 
-        void loadVoxels(const std::filesystem::directory_entry &type, uint32_t &numVoxels, std::map<uint32_t, std::pair<iAABB, std::vector<glm::ivec3>>> &voxels) const override {
+        void loadVoxels(const std::filesystem::directory_entry &type, uint64_t &numVoxels, std::map<uint32_t, std::pair<iAABB, std::vector<glm::ivec3>>> &voxels) const override {
             std::vector<char> voxelsRaw;
 
             const uint64_t bytesVoxels = std::filesystem::file_size(type.path());
-            if (bytesVoxels / sizeof(glm::ivec4) > UINT32_MAX) {
-                throw std::runtime_error("numVoxels > UINT32_MAX");
-            }
             numVoxels = bytesVoxels / sizeof(glm::ivec4);
             voxelsRaw.resize(bytesVoxels);
             std::ifstream(type.path(), std::ios::binary).read(voxelsRaw.data(), static_cast<std::streamsize>(bytesVoxels));
 
             const auto *voxelsVec = reinterpret_cast<glm::ivec4 *>(voxelsRaw.data());
 
-            // std::map<int32_t, std::map<int32_t, std::map<int32_t, bool>>> voxelsMap3D;
-            // uint64_t duplicateVoxels = 0;
-
-            for (uint32_t i = 0; i < numVoxels; i++) {
+            for (uint64_t i = 0; i < numVoxels; i++) {
                 const auto voxel = voxelsVec[i];
                 const auto voxelCoordinates = glm::ivec3(voxel.x, voxel.y, voxel.z);
 
                 voxels[voxel.w].second.push_back(voxelCoordinates);
                 voxels[voxel.w].first.expand(voxelCoordinates);
                 voxels[voxel.w].first.expand(voxelCoordinates + glm::ivec3(1, 1, 1));
-
-                // if (voxelsMap3D.contains(voxel.x)) {
-                //     if (voxelsMap3D[voxel.x].contains(voxel.y)) {
-                //         if (voxelsMap3D[voxel.x][voxel.y].contains(voxel.z)) {
-                //             std::cout << "duplicate voxel: " << voxel.x << "," << voxel.y << "," << voxel.z << std::endl;
-                //             duplicateVoxels++;
-                //         } else {
-                //             voxelsMap3D[voxel.x][voxel.y][voxel.z] = true;
-                //         }
-                //     } else {
-                //         voxelsMap3D[voxel.x][voxel.y][voxel.z] = true;
-                //     }
-                // } else {
-                //     voxelsMap3D[voxel.x][voxel.y][voxel.z] = true;
-                // }
-            }
-
-            // std::cout << "duplicate voxels: " << duplicateVoxels << " total voxels: " << numVoxels << std::endl;
+            }
         }
 
         [[nodiscard]] uint32_t toLabelId(const uint32_t typeId, const size_t instance) const override {
@@ -165,7 +110,81 @@ namespace raven {
         }
 
     private:
-        void loadTypes(const std::string &url, std::unordered_map<uint32_t, uint32_t> &cellIdToTypeId) const {
+        static constexpr int32_t SLAB_DEPTH = 16; // one layer of 16^3 bricks
+
+        // streams the payload of Id voxels in slabs of SLAB_DEPTH slices and extracts the voxels of every type
+        template<typename Id>
+        void extractVolume(std::ifstream &nrrd, const std::string &filename, const std::streamoff payloadOffset, const glm::ivec3 dimensions, const LabelRemap &remap, std::map<uint32_t, uint64_t> &numVoxels) const {
+            // the volume is 8-16GiB (uint32), it is streamed in slabs of SLAB_DEPTH slices and the next slab is read while the current one is scanned
+            const uint64_t sliceVoxels = static_cast<uint64_t>(dimensions[0]) * static_cast<uint64_t>(dimensions[1]);
+            const uint64_t byteSize = sliceVoxels * static_cast<uint64_t>(dimensions[2]) * sizeof(Id);
+            if (const uint64_t fileSize = std::filesystem::file_size(filename); fileSize < payloadOffset + byteSize) {
+                throw std::runtime_error("Only " + std::to_string(fileSize - payloadOffset) + " bytes of expected " + std::to_string(byteSize) + " bytes could be read from NRRD file.");
+            }
+            const int32_t numSlabs = (dimensions[2] + SLAB_DEPTH - 1) / SLAB_DEPTH;
+
+            const auto readSlab = [&nrrd, &filename, &dimensions, payloadOffset, sliceVoxels](const int32_t z0, std::vector<Id> &slab) {
+                slab.resize(sliceVoxels * std::min(SLAB_DEPTH, dimensions[2] - z0));
+                nrrd.seekg(payloadOffset + static_cast<std::streamoff>(z0 * sliceVoxels * sizeof(Id)));
+                nrrd.read(reinterpret_cast<char *>(slab.data()), static_cast<std::streamsize>(slab.size() * sizeof(Id)));
+                if (!nrrd) {
+                    throw std::runtime_error("Failed to read slab at z = " + std::to_string(z0) + " from NRRD file " + filename + ".");
+                }
+            };
+
+            VoxelWriter writer = createVoxelWriter();
+            std::vector<Id> slab;
+            std::vector<Id> nextSlab;
+            readSlab(0, slab);
+            for (int32_t z0 = 0; z0 < dimensions[2]; z0 += SLAB_DEPTH) {
+                std::future<void> next;
+                if (z0 + SLAB_DEPTH < dimensions[2]) {
+                    next = std::async(std::launch::async, readSlab, z0 + SLAB_DEPTH, std::ref(nextSlab));
+                }
+
+                std::map<uint32_t, std::vector<glm::ivec4>> voxels;
+                extractSlabVoxels(slab, z0, dimensions, remap, voxels);
+                for (const auto &[typeId, typeVoxels]: voxels) {
+                    numVoxels[typeId] += typeVoxels.size();
+                }
+                writeVoxels(writer, voxels, false); // the slab covers whole bricks, they are complete once written
+
+                if (next.valid()) {
+                    next.get();
+                }
+                std::swap(slab, nextSlab);
+                std::cout << "[" << filename << "] Slab " << z0 / SLAB_DEPTH + 1 << "/" << numSlabs << " extracted." << std::endl;
+            }
+            writer.close();
+        }
+
+        // extracts the voxels of the slab that starts at slice z0, the rows of the slab are distributed among the threads
+        template<typename Id>
+        void extractSlabVoxels(const std::vector<Id> &slab, const int32_t z0, const glm::ivec3 dimensions, const LabelRemap &remap, std::map<uint32_t, std::vector<glm::ivec4>> &outVoxels) const {
+            const auto numRows = static_cast<int64_t>(slab.size() / dimensions[0]);
+#pragma omp parallel num_threads(m_numThreads)
+            {
+                std::map<uint32_t, std::vector<glm::ivec4>> voxels;
+#pragma omp for schedule(dynamic, 16) nowait
+                for (int64_t row = 0; row < numRows; row++) {
+                    const auto vy = static_cast<int32_t>(row % dimensions[1]);
+                    const auto vz = z0 + static_cast<int32_t>(row / dimensions[1]);
+                    remap.scanRow(slab.data() + row * dimensions[0], dimensions[0], [&voxels, vy, vz](const uint32_t typeId, const Id cellId, const uint32_t begin, const uint32_t end) {
+                        auto &typeVoxels = voxels[typeId];
+                        for (uint32_t vx = begin; vx < end; vx++) {
+                            typeVoxels.emplace_back(static_cast<int32_t>(vx), vy, vz, static_cast<uint32_t>(cellId)); // use cellId for subdivision, mapped cell ids are 32bit
+                        }
+                    });
+                }
+#pragma omp critical
+                for (auto &[typeId, typeVoxels]: voxels) {
+                    auto &out = outVoxels[typeId];
+                    out.insert(out.end(), typeVoxels.begin(), typeVoxels.end());
+                }
+            }
+        }
+
+        void loadTypes(const std::string &url, std::unordered_map<uint64_t, uint32_t> &cellIdToTypeId) const {
             std::ifstream csv(url);
             if (!csv.is_open()) {
                 throw std::runtime_error("Unable to open csv file: " + url);
@@ -176,7 +195,7 @@ namespace raven {
             std::string line;
             while (std::getline(csv, line)) {
                 std::istringstream iss(line);
-                uint32_t cellId;
+                uint64_t cellId;
                 uint32_t type;
                 if (parseCSVLine(iss, &cellId, &type)) {
                     cellIdToTypeId[cellId] = type;
@@ -190,11 +209,11 @@ namespace raven {
             std::cout << "Volume csv file parsed successfully. Found " << cellIdToTypeId.size() << " cell ids in file.";
         }
 
-        bool parseCSVLine(std::istringstream &iss, uint32_t *cellId, uint32_t *type) const {
+        bool parseCSVLine(std::istringstream &iss, uint64_t *cellId, uint32_t *type) const {
             std::string field;
 
             if (std::getline(iss, field, ' ')) {
-                *cellId = static_cast<uint32_t>(std::stoll(field));
+                *cellId = std::stoull(field);
             } else {
                 return false;
             }
@@ -1,21 +1,46 @@
 #pragma once
 #include "../Raystructs.h"
 #include "builder/DAG.h"
+#include "builder/DAGCompact.h"
+#include "builder/DAGExternalReduce.h"
+#include "builder/DAGInterner.h"
+#include "builder/MappedFile.h"
+#include "builder/Morton.h"
 #include "builder/Octree.h"
+#include "builder/RadixSort.h"
+#include "builder/VoxelBricks.h"
+#include "LabelScheduler.h"
+#include "VoxelWriter.h"
 #include "raven/util/AABB.h"
 
+#include <atomic>
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <functional>
+#include <numeric>
 #include <regex>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <omp.h>
+#include <tbb/parallel_for.h>
 
 namespace raven {
     class SegmentationVolumeConverter {
     public:
+        enum DAGBuilder {
+            DAG_BUILDER_REDUCE,       // expand all octrees into the full hierarchy, then sort and compact it with DAG::reduce
+            DAG_BUILDER_HASH_CONSING, // deduplicate nodes while the octrees are traversed, see hashConsing_fromOctree
+        };
+
+        enum Subdivision {
+            SUBDIVISION_MEDIAN_SPLIT,   // recursive median splits along the longest axis until the AABB fits into 16^3, see subdivide
+            SUBDIVISION_MORTON_BUCKETS, // bucket the voxels into the 16^3 cells of the label AABB by sorting Morton keys, see subdivideMorton
+            SUBDIVISION_GRID_ALIGNED,   // bucket the voxels into the cells of the global 16^3 lattice, the octrees are anchored at the lattice, see subdivideMorton (render with grid="true", see Volume)
+        };
+
         SegmentationVolumeConverter(std::string prefix, std::string prefixPlural, std::string data, std::string scene, const bool svdagOccupancyField) : m_prefix(std::move(prefix)), m_prefixPlural(std::move(prefixPlural)), m_data(std::move(data)), m_scene(std::move(scene)), m_svdagOccupancyField(svdagOccupancyField) {}
 
         virtual ~SegmentationVolumeConverter() = default;
@@ -23,27 +48,54 @@ namespace raven {
         virtual void rawDataToVoxelTypes() = 0;
 
         void voxelTypesToAABBsAndOctrees() const {
-            std::filesystem::create_directories(m_data + "/" + m_scene + "/" + m_stringSVO + "/aabb");
-            std::filesystem::create_directories(m_data + "/" + m_scene + "/" + m_stringSVO + "/lod");
+            voxelTypesToAABBsAndLODs(true, false);
+        }
 
-            uint32_t types = 0;
+        /**
+         * Fused voxelTypesToAABBsAndOctrees and AABBsAndOctreesToAABBsAndDAGs: the octrees of a label are kept in memory and turned into its SVDAG right away,
+         * the SVO files are only written if writeSVO is set (e.g. to render with LOD_TYPE_SVO).
+         */
+        void voxelTypesToAABBsAndDAGs(const bool writeSVO = false) const {
+            voxelTypesToAABBsAndLODs(writeSVO, true);
+        }
 
-            // omp_set_dynamic(0);
-            // omp_set_num_threads(4);
-            // std::cout << "Using " << omp_get_max_threads() << " threads." << std::endl;
+        void setNumThreads(const uint32_t numThreads) { m_numThreads = std::max(1u, numThreads); }
+        void setMemoryBudget(const uint64_t memoryBudget) { m_memoryBudget = memoryBudget; }
+        void setReduceMode(const DAG::ReduceMode reduceMode) { m_reduceMode = reduceMode; }
+        void setDAGBuilder(const DAGBuilder dagBuilder) { m_dagBuilder = dagBuilder; }
+        void setExternalMergeMemoryCap(const uint64_t memoryCap) { m_externalMergeMemoryCap = memoryCap; } // 0: merge in memory
+        void setOctreeBuilder(const Octree::Builder octreeBuilder) { m_octreeBuilder = octreeBuilder; }
+        void setVoxelLayout(const VoxelWriter::Layout voxelLayout) { m_voxelLayout = voxelLayout; }
+        void setMergeSegmentNodes(const uint64_t mergeSegmentNodes) { m_mergeSegmentNodes = std::clamp<uint64_t>(mergeSegmentNodes, 1, DAG::invalidPointer()); }
+        void setChunkVoxels(const uint64_t chunkVoxels) { m_chunkVoxels = std::max<uint64_t>(1, chunkVoxels); }
+        void setCompactLeafTable(const bool compactLeafTable) { m_compactLeafTable = compactLeafTable; }
+        void setAppendReserve(const double appendReserve) { m_appendReserve = std::max(0.0, appendReserve); } // fraction of free slots per merged level, see writeDAGAppendIndex
+        void setSubdivision(const Subdivision subdivision) {
+            m_subdivision = subdivision;
+            // grid aligned octrees are not anchored at the minimum of their AABB, but at (aabb.m_min >> 4) * 16 (anchor offset aabb.m_min & 15), keep them apart
+            m_stringSVO = subdivision == SUBDIVISION_GRID_ALIGNED ? "svo_grid" : "svo";
+            m_stringSVDAG = subdivision == SUBDIVISION_GRID_ALIGNED ? "svdag_grid" : "svdag";
+        }
 
-            std::vector<std::filesystem::directory_entry> files;
-            for (const auto &type: std::filesystem::directory_iterator(m_data + "/" + m_scene + "/" + m_stringVoxels)) {
-                files.push_back(type);
-            }
+        void AABBsAndOctreesToAABBsAndDAGs() const {
+            std::filesystem::create_directories(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/aabb");
+            std::filesystem::create_directories(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/lod");
+            std::filesystem::create_directories(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/lod_data");
 
-            double totalTime = 0;
+            LabelScheduler scheduler(m_numThreads, m_memoryBudget);
+            std::atomic<uint32_t> types = 0;
 
-            // #pragma omp parallel for
-            for (uint32_t i = 0; i < files.size(); i++) {
-                const auto &type = files[i];
+            // buffers are reused by all labels processed on the same worker
+            std::vector<DAGBuildArena> arenas(m_numThreads);
+
+            std::vector<LabelScheduler::Job> jobs;
+            for (const auto &type: std::filesystem::directory_iterator(m_data + "/" + m_scene + "/" + m_stringSVO + "/aabb")) {
                 std::string filename = type.path().filename().string();
-                const std::regex rgx("[" + m_prefix + "]?([0-9]+)\\.[bin|idx]");
+                if (!std::filesystem::exists(m_data + "/" + m_scene + "/" + m_stringSVO + "/lod/" + filename)) {
+                    std::cout << "Skipping " << filename << ": Missing LOD file." << std::endl;
+                    continue;
+                }
+                const std::regex rgx(m_prefix + "([0-9]+)\\.bin");
                 std::smatch matches;
                 std::regex_search(filename, matches, rgx);
                 if (matches.size() != 2) {
@@ -51,239 +103,1012 @@ namespace raven {
                     continue;
                 }
                 const uint32_t typeId = static_cast<uint32_t>(std::stoul(matches[1]));
-                if (std::filesystem::exists(m_data + "/" + m_scene + "/" + m_stringSVO + "/aabb/" + m_prefix + std::to_string(typeId) + ".bin") && std::filesystem::exists(m_data + "/" + m_scene + "/" + m_stringSVO + "/lod/" + m_prefix + std::to_string(typeId) + ".bin")) {
-                    std::cout << "Skipping " << filename << ". SVO already exists." << std::endl;
+                if (std::filesystem::exists(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/aabb/" + m_prefix + std::to_string(typeId) + ".bin") && std::filesystem::exists(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/lod/" + m_prefix + std::to_string(typeId) + ".bin") && std::filesystem::exists(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/lod_data/" + m_prefix + std::to_string(typeId) + ".bin")) {
+                    std::cout << "Skipping " << filename << ". SVDAG already exists." << std::endl;
                     continue;
                 }
 
-                std::cout << "[" << filename << "]" << std::endl;
+                const uint64_t bytesLOD = std::filesystem::file_size(m_data + "/" + m_scene + "/" + m_stringSVO + "/lod/" + filename);
+                jobs.push_back({.m_name = filename,
+                                .m_footprint = octreeFootprint(type.file_size(), bytesLOD),
+                                .m_work = [this, type, filename, typeId, &scheduler, &types, &arenas](const uint32_t worker) {
+                                    AABBsAndOctreeToAABBsAndDAG(type, filename, typeId, arenas[worker], scheduler);
+                                    scheduler.log("Processed " + std::to_string(++types) + ".");
+                                }});
+            }
 
-                uint32_t numVoxels;
-                std::map<uint32_t, std::pair<iAABB, std::vector<glm::ivec3>>> voxels;
-                loadVoxels(type, numVoxels, voxels);
+            std::cout << "[SVDAG] Processing " << jobs.size() << " file(s) using " << m_numThreads << " thread(s) and a memory budget of " << static_cast<double>(m_memoryBudget) * glm::pow(2, -30) << "[GiB]." << std::endl;
+            scheduler.run(std::move(jobs));
+            scheduler.printTimings("SVDAG");
+        }
 
-                std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        struct DAGFileInfo {
+            std::string m_folder;
 
-                // subdivide
-                std::vector<Octree::OctreeBuildInfo> octreeBuildInfos;
-                std::cout << "[" << filename << "] Subdividing " << voxels.size() << " id(s)." << std::endl;
-                size_t instance = 0;
-                for (auto &[id, voxel]: voxels) {
-                    subdivide(voxel.second, 0, voxel.second.size(), voxel.first, toLabelId(typeId, instance), octreeBuildInfos);
-                    instance++;
-                }
-                std::cout << "[" << filename << "] Subdivided." << std::endl;
+            std::vector<std::string> m_aabbs;
+            std::string m_lod;
+            std::string m_lodData;
 
-                // build octrees
-                Octree octreeBuilder;
-                octreeBuilder.buildOctrees(octreeBuildInfos);
-                std::cout << "[" << filename << "] SVOs built." << std::endl;
+            [[nodiscard]] bool exists(const std::string &data, const std::string &scene) const {
+                for (const auto &aabb: m_aabbs) {
+                    if (!std::filesystem::exists(data + "/" + scene + "/" + m_folder + "/aabb/" + aabb + ".bin")) {
+                        return false;
+                    }
+                }
+                return std::filesystem::exists(data + "/" + scene + "/" + m_folder + "/lod/" + m_lod + ".bin") &&
+                       std::filesystem::exists(data + "/" + scene + "/" + m_folder + "/lod_data/" + m_lodData + ".bin");
+            }
+        };
 
-                std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
-                double cpuTime = (static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) * std::pow(10, -3));
-                totalTime += cpuTime;
-                std::cout << "[SVO] " << cpuTime << "[ms]" << std::endl;
+        // combined, not yet reduced SVDAGs of the labels of one merge segment, see loadDAGsCombine
+        struct DAGPool {
+            std::vector<DAG::DAGRoot> m_dagRoot;
+            std::vector<DAG::DAGNode> m_dag;
+            std::vector<DAG::DAGLevel> m_dagLevels;
+        };
 
-                // write
-                std::vector<VoxelAABB> aabbs;
-                for (uint32_t j = 0; j < octreeBuildInfos.size(); j++) {
-                    const auto &octreeBuildInfo = octreeBuildInfos[j];
-                    aabbs.push_back(VoxelAABB{octreeBuildInfo.aabb.m_min.x, octreeBuildInfo.aabb.m_min.y, octreeBuildInfo.aabb.m_min.z,
-                                              octreeBuildInfo.aabb.m_max.x, octreeBuildInfo.aabb.m_max.y, octreeBuildInfo.aabb.m_max.z,
-                                              octreeBuildInfo.labelId, octreeBuilder.m_octreeIndices[j]});
+        /**
+         * Merges the SVDAGs into <prefixPlural>.bin. If the merged SVDAG would exceed m_mergeSegmentNodes, the labels are split into consecutive segments
+         * whose merged SVDAGs do not (see mergeSegments), and every segment is merged into <prefixPlural>_<segment>.bin on its own, such that the merged SVDAG of a segment fits 32bit pointers.
+         * Nodes are shared within a segment. The renderer places every segment in its own LOD buffer (see Volume), i.e. a segment is a separate <lod> of the volume.
+         * An unsegmented merged SVDAG gets the index that appendDAGs appends labels with (see writeDAGAppendIndex).
+         */
+        void mergeDAGs(const std::vector<DAGFileInfo> &dagFileInfos) const {
+            const std::vector<std::vector<DAGFileInfo>> segments = mergeSegments(dagFileInfos);
+            if (segments.size() == 1) {
+                mergeSegment(segments.front(), m_prefixPlural);
+                writeDAGAppendIndex(m_prefixPlural);
+            } else {
+                // segmented SVDAGs are not appended to
+                for (const char *folder: {"/lod_index/", "/lod_refs/", "/lod_free/"}) {
+                    std::filesystem::remove(m_data + "/" + m_scene + "/" + stringSVDAG(true) + folder + m_prefixPlural + ".bin");
+                }
+                for (uint64_t segment = 0; segment < segments.size(); segment++) {
+                    const std::string name = mergedName(segments.size(), segment);
+                    std::cout << "[SVDAG] Segment " << name << ":";
+                    for (const auto &dagFileInfo: segments[segment]) {
+                        for (const auto &aabbFile: dagFileInfo.m_aabbs) {
+                            std::cout << " " << aabbFile;
+                        }
+                    }
+                    std::cout << std::endl;
+                    mergeSegment(segments[segment], name);
                 }
+            }
+            memoryReport(dagFileInfos);
+        }
 
-                std::ofstream(m_data + "/" + m_scene + "/" + m_stringSVO + "/aabb/" + m_prefix + std::to_string(typeId) + ".bin", std::ios::binary)
-                        .write(reinterpret_cast<char *>(aabbs.data()), static_cast<std::streamsize>(aabbs.size() * sizeof(VoxelAABB)));
-                std::ofstream(m_data + "/" + m_scene + "/" + m_stringSVO + "/lod/" + m_prefix + std::to_string(typeId) + ".bin", std::ios::binary)
-                        .write(reinterpret_cast<char *>(octreeBuilder.m_octrees.data()), static_cast<std::streamsize>(octreeBuilder.m_octrees.size() * sizeof(Octree::OctreeNode)));
+        void mergeSegment(const std::vector<DAGFileInfo> &dagFileInfos, const std::string &name) const {
+            if (!dagFileInfos.empty() && std::all_of(dagFileInfos.begin(), dagFileInfos.end(), [this](const DAGFileInfo &dagFileInfo) {
+                    std::vector<DAG::DAGLevel> levels;
+                    return readDAGLevels(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/lod_data/" + dagFileInfo.m_lodData + ".bin", levels) == DAG::SORT_ORDER_LEXICOGRAPHIC;
+                })) {
+                std::cout << "[SVDAG] All SVDAGs are in lexicographic order, merging with k-way merge." << std::endl;
+                mergeSortedDAGs(dagFileInfos, name);
+            } else if (m_externalMergeMemoryCap > 0) {
+                mergeDAGsExternal(dagFileInfos, name);
+            } else {
+                mergeDAGsInMemory(dagFileInfos, name);
+            }
+        }
 
-                std::cout << "Processed " << ++types << "." << std::endl;
+        /**
+         * Consecutive labels whose merged SVDAG has at most m_mergeSegmentNodes nodes. The nodes of the current segment are interned while the labels are added,
+         * a label starts a new segment if its nodes that are not shared with the segment would exceed the limit. The interned nodes of one segment are kept in memory,
+         * if the input nodes of all labels do not exceed the limit, they form a single segment without interning.
+         */
+        [[nodiscard]] std::vector<std::vector<DAGFileInfo>> mergeSegments(const std::vector<DAGFileInfo> &dagFileInfos) const {
+            uint64_t inDAGCount = 0;
+            for (const auto &dagFileInfo: dagFileInfos) {
+                inDAGCount += std::filesystem::file_size(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/lod/" + dagFileInfo.m_lod + ".bin") / sizeof(DAG::DAGNode);
+            }
+            if (inDAGCount <= m_mergeSegmentNodes) {
+                return {dagFileInfos};
             }
 
-            std::cout << "[SVO] Total time: " << totalTime << "[ms]" << std::endl;
+            std::vector<std::vector<DAGFileInfo>> segments(1);
+            std::unordered_map<DAG::DAGNode, uint32_t, DAGNodeHash, DAGNodeEqual> segmentNodes; // merged node -> index in the segment
+            for (const auto &dagFileInfo: dagFileInfos) {
+                std::vector<DAG::DAGNode> dag(std::filesystem::file_size(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/lod/" + dagFileInfo.m_lod + ".bin") / sizeof(DAG::DAGNode));
+                std::ifstream(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/lod/" + dagFileInfo.m_lod + ".bin", std::ios::binary).read(reinterpret_cast<char *>(dag.data()), static_cast<std::streamsize>(dag.size() * sizeof(DAG::DAGNode)));
+
+                // nodes of the label that are not in the segment yet, children are stored before their parents
+                const auto addedNodes = [&dag, &segmentNodes]() {
+                    std::unordered_map<DAG::DAGNode, uint32_t, DAGNodeHash, DAGNodeEqual> added;
+                    std::vector<uint32_t> remap(dag.size());
+                    for (uint64_t i = 0; i < dag.size(); i++) {
+                        DAG::DAGNode node = dag[i];
+                        if (!node.isLeaf()) {
+                            node.child0 = remap[node.child0];
+                            node.child1 = remap[node.child1];
+                            node.child2 = remap[node.child2];
+                            node.child3 = remap[node.child3];
+                            node.child4 = remap[node.child4];
+                            node.child5 = remap[node.child5];
+                            node.child6 = remap[node.child6];
+                            node.child7 = remap[node.child7];
+                        }
+                        if (const auto it = segmentNodes.find(node); it != segmentNodes.end()) {
+                            remap[i] = it->second;
+                        } else {
+                            remap[i] = added.try_emplace(node, static_cast<uint32_t>(segmentNodes.size() + added.size())).first->second;
+                        }
+                    }
+                    return added;
+                };
+
+                auto added = addedNodes();
+                if (segmentNodes.size() + added.size() > m_mergeSegmentNodes && !segments.back().empty()) {
+                    segments.emplace_back();
+                    segmentNodes.clear();
+                    added = addedNodes();
+                }
+                if (segmentNodes.size() + added.size() > m_mergeSegmentNodes) {
+                    throw std::runtime_error("SVDAG " + dagFileInfo.m_lod + " exceeds the merge segment size.");
+                }
+                segments.back().push_back(dagFileInfo);
+                segmentNodes.merge(added);
+            }
+            return segments;
         }
 
-        void AABBsAndOctreesToAABBsAndDAGs() const {
-            std::filesystem::create_directories(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/aabb");
-            std::filesystem::create_directories(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/lod");
-            std::filesystem::create_directories(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/lod_data");
+        [[nodiscard]] std::string mergedName(const uint64_t numSegments, const uint64_t segment) const { return mergedName(m_prefixPlural, numSegments, segment); }
+
+        [[nodiscard]] static std::string mergedName(const std::string &prefixPlural, const uint64_t numSegments, const uint64_t segment) {
+            return numSegments == 1 ? prefixPlural : prefixPlural + "_" + std::to_string(segment);
+        }
 
-            uint32_t types = 0;
+        /**
+         * Encodes the per label SVDAGs and the merged SVDAG with the variable-size child mask nodes of DAGCompact into <svdag>_compact and <svdag>_merged_compact,
+         * the AABBs point to their roots. With setCompactLeafTable, the leaves are moved into the leaf table of the stream. Call after mergeDAGs with the same labels.
+         * Prints the size of the LOD buffers of both encodings (Volume::getLODBufferSize).
+         */
+        void compactDAGs(const std::vector<DAGFileInfo> &dagFileInfos) const {
+            const auto mib = [](const uint64_t bytes) { return static_cast<double>(bytes) * glm::pow(2, -20); };
 
-            std::vector<std::filesystem::directory_entry> files;
-            for (const auto &type: std::filesystem::directory_iterator(m_data + "/" + m_scene + "/" + m_stringSVO + "/aabb")) {
-                files.push_back(type);
+            uint64_t bytesLOD = 0;
+            uint64_t bytesCompactLOD = 0;
+            for (const auto &dagFileInfo: dagFileInfos) {
+                compactDAG(dagFileInfo.m_folder, dagFileInfo.m_aabbs, dagFileInfo.m_lod, stringSVDAGCompact(false), bytesLOD, bytesCompactLOD);
             }
 
-            double totalTime = 0;
+            uint64_t bytesMergedLOD = 0;
+            uint64_t bytesCompactMergedLOD = 0;
+            const std::vector<std::vector<DAGFileInfo>> segments = mergeSegments(dagFileInfos);
+            for (uint64_t segment = 0; segment < segments.size(); segment++) {
+                std::vector<std::string> aabbFiles;
+                for (const auto &dagFileInfo: segments[segment]) {
+                    aabbFiles.insert(aabbFiles.end(), dagFileInfo.m_aabbs.begin(), dagFileInfo.m_aabbs.end());
+                }
+                compactDAG(stringSVDAG(true), aabbFiles, mergedName(segments.size(), segment), stringSVDAGCompact(true), bytesMergedLOD, bytesCompactMergedLOD);
+            }
 
-            for (uint32_t i = 0; i < files.size(); i++) {
-                const auto &type = files[i];
-                std::string filename = type.path().filename().string();
-                if (!std::filesystem::exists(m_data + "/" + m_scene + "/" + m_stringSVO + "/lod/" + filename)) {
-                    std::cout << "Skipping " << filename << ": Missing LOD file." << std::endl;
-                    continue;
+            std::cout << "[Memory] SVDAG LOD buffer: " << mib(bytesLOD) << "[MiB], compact " << mib(bytesCompactLOD) << "[MiB] (" << 100.0 * static_cast<double>(bytesCompactLOD) / static_cast<double>(std::max<uint64_t>(1, bytesLOD)) << "%)." << std::endl;
+            std::cout << "[Memory] SVDAG merged LOD buffer: " << mib(bytesMergedLOD) << "[MiB], compact " << mib(bytesCompactMergedLOD) << "[MiB] (" << 100.0 * static_cast<double>(bytesCompactMergedLOD) / static_cast<double>(std::max<uint64_t>(1, bytesMergedLOD)) << "%)." << std::endl;
+        }
+
+        /**
+         * Prints the number of AABBs and nodes and the memory of the SVOs, the per label SVDAGs and the merged SVDAG of the current subdivision mode,
+         * such that the modes can be compared (fewer SVDAG nodes vs. more AABBs).
+         */
+        void memoryReport(const std::vector<DAGFileInfo> &dagFileInfos) const {
+            const std::string scene = m_data + "/" + m_scene + "/";
+            const auto fileSize = [](const std::string &path) -> uint64_t { return std::filesystem::exists(path) ? std::filesystem::file_size(path) : 0; };
+            const auto mib = [](const uint64_t bytes) { return static_cast<double>(bytes) * glm::pow(2, -20); };
+
+            uint64_t bytesSVOAABB = 0;
+            uint64_t bytesSVOLOD = 0;
+            if (std::filesystem::exists(scene + m_stringSVO + "/aabb")) {
+                for (const auto &type: std::filesystem::directory_iterator(scene + m_stringSVO + "/aabb")) {
+                    bytesSVOAABB += type.file_size();
+                    bytesSVOLOD += fileSize(scene + m_stringSVO + "/lod/" + type.path().filename().string());
                 }
-                const std::regex rgx(m_prefix + "([0-9]+)\\.bin");
-                std::smatch matches;
-                std::regex_search(filename, matches, rgx);
-                if (matches.size() != 2) {
-                    std::cout << "Skipping " << filename << "." << std::endl;
-                    continue;
+            }
+
+            uint64_t bytesAABB = 0;
+            uint64_t bytesSVDAGLOD = 0;
+            for (const auto &dagFileInfo: dagFileInfos) {
+                for (const auto &aabbFile: dagFileInfo.m_aabbs) {
+                    bytesAABB += fileSize(scene + dagFileInfo.m_folder + "/aabb/" + aabbFile + ".bin");
                 }
-                const uint32_t typeId = static_cast<uint32_t>(std::stoul(matches[1]));
-                if (std::filesystem::exists(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/aabb/" + m_prefix + std::to_string(typeId) + ".bin") && std::filesystem::exists(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/lod/" + m_prefix + std::to_string(typeId) + ".bin") && std::filesystem::exists(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/lod_data/" + m_prefix + std::to_string(typeId) + ".bin")) {
-                    std::cout << "Skipping " << filename << ". SVDAG already exists." << std::endl;
-                    continue;
+                bytesSVDAGLOD += fileSize(scene + dagFileInfo.m_folder + "/lod/" + dagFileInfo.m_lod + ".bin");
+            }
+            uint64_t bytesMergedAABB = 0;
+            if (std::filesystem::exists(scene + stringSVDAG(true) + "/aabb")) {
+                for (const auto &aabb: std::filesystem::directory_iterator(scene + stringSVDAG(true) + "/aabb")) {
+                    bytesMergedAABB += aabb.file_size(); // all labels of the merged SVDAG, including appended ones
+                }
+            }
+            uint64_t bytesMergedLOD = 0;
+            if (std::filesystem::exists(scene + stringSVDAG(true) + "/lod")) {
+                for (const auto &lod: std::filesystem::directory_iterator(scene + stringSVDAG(true) + "/lod")) {
+                    bytesMergedLOD += lod.file_size(); // all segments
                 }
+            }
 
-                std::cout << "[" << filename << "]" << std::endl;
+            std::cout << "[Memory] Subdivision: " << stringSubdivision(m_subdivision) << "." << std::endl;
+            std::cout << "[Memory] SVO: " << bytesSVOAABB / sizeof(VoxelAABB) << " AABBs (" << mib(bytesSVOAABB) << "[MiB]), " << bytesSVOLOD / sizeof(Octree::OctreeNode) << " nodes (" << mib(bytesSVOLOD) << "[MiB])." << std::endl;
+            std::cout << "[Memory] SVDAG: " << bytesAABB / sizeof(VoxelAABB) << " AABBs (" << mib(bytesAABB) << "[MiB]), " << bytesSVDAGLOD / sizeof(DAG::DAGNode) << " nodes (" << mib(bytesSVDAGLOD) << "[MiB])." << std::endl;
+            std::cout << "[Memory] SVDAG merged: " << bytesMergedAABB / sizeof(VoxelAABB) << " AABBs (" << mib(bytesMergedAABB) << "[MiB]), " << bytesMergedLOD / sizeof(DAG::DAGNode) << " nodes (" << mib(bytesMergedLOD) << "[MiB]), total " << mib(bytesMergedAABB + bytesMergedLOD) << "[MiB]." << std::endl;
+        }
 
-                std::ifstream file(type.path(), std::ios::binary);
+        static std::string stringSubdivision(const Subdivision subdivision) {
+            switch (subdivision) {
+                case SUBDIVISION_MEDIAN_SPLIT:
+                    return "median split";
+                case SUBDIVISION_MORTON_BUCKETS:
+                    return "Morton buckets";
+                case SUBDIVISION_GRID_ALIGNED:
+                    return "grid aligned";
+            }
+            return "unknown";
+        }
 
-                std::vector<char> aabbRaw;
-                std::vector<char> lodRaw;
+        void mergeDAGsInMemory(const std::vector<DAGFileInfo> &dagFileInfos, const std::string &name) const {
+            std::vector<DAG::DAGRoot> dagRoot;
+            std::vector<DAG::DAGNode> dag;
+            std::vector<DAG::DAGLevel> dagLevels;
 
-                uint32_t numAABB;
-                {
-                    uint32_t bytesAABB = std::filesystem::file_size(type.path());
-                    uint32_t bytesPerAABB = sizeof(VoxelAABB);
-                    numAABB = bytesAABB / bytesPerAABB;
-                    aabbRaw.resize(bytesAABB);
-                    std::ifstream(type.path(), std::ios::binary).read(aabbRaw.data(), bytesAABB);
+            loadDAGsCombine(m_data, m_scene, dagFileInfos, dagRoot, dag, dagLevels);
 
-                    uint32_t bytesLOD = std::filesystem::file_size(m_data + "/" + m_scene + "/" + m_stringSVO + "/lod/" + filename);
-                    uint32_t bytesPerLOD = sizeof(Octree::OctreeNode);
-                    lodRaw.resize(bytesLOD);
-                    std::ifstream(m_data + "/" + m_scene + "/" + m_stringSVO + "/lod/" + filename, std::ios::binary).read(lodRaw.data(), bytesLOD);
+            DAG dagConstruct(dagRoot.data(), dagRoot.size(), dag.data(), dag.size(), dagLevels);
+            std::cout << "[SVDAG] Start verification." << std::endl;
+            dagConstruct.verify();
+            std::cout << "[SVDAG] End verification." << std::endl;
+
+            std::cout << "[SVDAG] Start reduce." << std::endl;
+            uint32_t outDAGCount;
+            std::vector<DAG::DAGLevel> outDAGLevels(dagLevels.size());
+            dagConstruct.reduce(&outDAGCount, outDAGLevels, m_reduceMode);
+            std::cout << "[SVDAG] End reduce." << std::endl;
+
+            std::cout << "[SVDAG] Start verification." << std::endl;
+            DAG dagVerify(dagRoot.data(), dagRoot.size(), dag.data(), outDAGCount, outDAGLevels);
+            dagVerify.verify();
+            std::cout << "[SVDAG] End verification." << std::endl;
+
+            // write
+            std::filesystem::create_directories(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/aabb");
+            std::filesystem::create_directories(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/lod");
+            std::filesystem::create_directories(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/lod_data");
+
+            uint64_t c = 0;
+            for (uint64_t vol = 0; vol < dagFileInfos.size(); vol++) {
+                const auto &dagFileInfo = dagFileInfos[vol];
+
+                for (uint64_t aabb = 0; aabb < dagFileInfo.m_aabbs.size(); aabb++) {
+                    const auto &aabbFile = dagFileInfo.m_aabbs[aabb];
+
+                    uint64_t bytesAABB = std::filesystem::file_size(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/aabb/" + aabbFile + ".bin");
+                    uint64_t bytesPerAABB = sizeof(VoxelAABB);
+                    uint64_t numAABB = bytesAABB / bytesPerAABB;
+                    std::vector<VoxelAABB> inAABB(numAABB);
+                    std::ifstream(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/aabb/" + aabbFile + ".bin", std::ios::binary).read(reinterpret_cast<char *>(inAABB.data()), static_cast<std::streamsize>(bytesAABB));
+
+                    for (uint64_t i = 0; i < numAABB; i++) {
+                        inAABB[i].lod = dagRoot[c];
+                        c++;
+                    }
+
+                    std::ofstream(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/aabb/" + aabbFile + ".bin", std::ios::binary).write(reinterpret_cast<char *>(inAABB.data()), static_cast<std::streamsize>(bytesAABB));
                 }
+            }
 
-                std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            std::ofstream(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/lod/" + name + ".bin", std::ios::binary).write(reinterpret_cast<char *>(dag.data()), static_cast<std::streamsize>(outDAGCount * sizeof(DAG::DAGNode)));
+            writeDAGLevels(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/lod_data/" + name + ".bin", outDAGLevels, DAG::sortOrder(m_reduceMode));
+        }
 
-                // dag
-                std::vector<DAG::DAGRoot> dagRoot(numAABB);
-                uint32_t dagRootCount = numAABB;
-                std::vector<DAG::DAGNode> dag;
-                std::vector<DAG::DAGLevel> dagLevels;
+        /**
+         * Merges per label SVDAGs whose levels are in SORT_ORDER_LEXICOGRAPHIC without combining and reducing them in memory.
+         * Levels are processed bottom up: the nodes of a level are streamed from all inputs, their child pointers are remapped to the merged lower levels,
+         * and the sorted streams are merged with a k-way merge that drops duplicates on the fly. The remapping is monotonic, hence the remapped inputs stay
+         * sorted and the merged SVDAG is in SORT_ORDER_LEXICOGRAPHIC again. Only the remapping tables (one index per input node) are kept in memory.
+         */
+        void mergeSortedDAGs(const std::vector<DAGFileInfo> &dagFileInfos, const std::string &name) const {
+            std::filesystem::create_directories(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/aabb");
+            std::filesystem::create_directories(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/lod");
+            std::filesystem::create_directories(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/lod_data");
 
-                // initialize
-                if (m_svdagOccupancyField) {
-                    svdagOccupancyField_fromOctree(reinterpret_cast<VoxelAABB *>(aabbRaw.data()), reinterpret_cast<Octree::OctreeNode *>(lodRaw.data()), dagRoot.data(), dagRootCount, dag, dagLevels);
-                } else {
-                    svdag_fromOctree(reinterpret_cast<VoxelAABB *>(aabbRaw.data()), reinterpret_cast<Octree::OctreeNode *>(lodRaw.data()), dagRoot.data(), dagRootCount, dag, dagLevels);
+            const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+            std::vector<SortedDAGStream> inputs(dagFileInfos.size());
+            uint64_t numLevels = 0;
+            uint64_t inDAGCount = 0;
+            for (uint64_t vol = 0; vol < dagFileInfos.size(); vol++) {
+                const auto &dagFileInfo = dagFileInfos[vol];
+                auto &input = inputs[vol];
+                if (readDAGLevels(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/lod_data/" + dagFileInfo.m_lodData + ".bin", input.levels) != DAG::SORT_ORDER_LEXICOGRAPHIC) {
+                    throw std::runtime_error("SVDAG " + dagFileInfo.m_lodData + " is not in lexicographic order.");
                 }
-                uint32_t dagCount = dagLevels[dagLevels.size() - 1].index + dagLevels[dagLevels.size() - 1].count;
+                input.lod.open(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/lod/" + dagFileInfo.m_lod + ".bin", std::ios::binary);
+                const uint64_t numLOD = std::filesystem::file_size(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/lod/" + dagFileInfo.m_lod + ".bin") / sizeof(DAG::DAGNode);
+                input.remap.assign(numLOD, DAG::invalidPointer());
+                numLevels = glm::max(numLevels, static_cast<uint64_t>(input.levels.size()));
+                inDAGCount += numLOD;
+            }
 
-                // construct
-                DAG dagConstruct(dagRoot.data(), dagRootCount, dag.data(), dagCount, dagLevels);
-                // dagConstruct.verify();
-                std::cout << "[" << filename << "] Start reduce." << std::endl;
-                uint32_t outDAGCount;
-                std::vector<DAG::DAGLevel> outDAGLevels(dagLevels.size());
-                dagConstruct.reduce(&outDAGCount, outDAGLevels);
-                std::cout << "[" << filename << "] End reduce." << std::endl;
-                // DAG dagVerify(dagRoot.data(), dagRootCount, dag.data(), outDAGCount, outDAGLevels);
-                // dagVerify.verify();
+            std::ofstream outLOD(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/lod/" + name + ".bin", std::ios::binary);
+            std::vector<DAG::DAGNode> outBuffer;
+            outBuffer.reserve(SortedDAGStream::BUFFER_SIZE);
+            std::vector<DAG::DAGLevel> outDAGLevels(numLevels);
+            uint64_t globalOffset = 0;
+
+            // min heap of the current node of every input, ties are broken by input index
+            const auto greater = [&inputs](const uint32_t a, const uint32_t b) {
+                const auto &nodeA = inputs[a].current;
+                const auto &nodeB = inputs[b].current;
+                return nodeB.lexicographicCompare(nodeA) || (nodeA.equals(nodeB) && a > b);
+            };
+            std::vector<uint32_t> heap;
+
+            for (uint32_t l = 0; l < numLevels; l++) {
+                heap.clear();
+                for (uint32_t vol = 0; vol < inputs.size(); vol++) {
+                    if (inputs[vol].beginLevel(l)) {
+                        heap.push_back(vol);
+                    }
+                }
+                std::make_heap(heap.begin(), heap.end(), greater);
+
+                auto &outLevel = outDAGLevels[l];
+                outLevel.index = static_cast<uint32_t>(globalOffset);
+                outLevel.count = 0;
+                DAG::DAGNode last{};
+                while (!heap.empty()) {
+                    std::pop_heap(heap.begin(), heap.end(), greater);
+                    auto &input = inputs[heap.back()];
+
+                    if (outLevel.count == 0 || !input.current.equals(last)) {
+                        if (globalOffset >= DAG::invalidPointer()) {
+                            throw std::runtime_error("Merged SVDAG exceeds 32bit node pointers.");
+                        }
+                        last = input.current;
+                        outBuffer.push_back(last);
+                        if (outBuffer.size() == SortedDAGStream::BUFFER_SIZE) {
+                            outLOD.write(reinterpret_cast<char *>(outBuffer.data()), static_cast<std::streamsize>(outBuffer.size() * sizeof(DAG::DAGNode)));
+                            outBuffer.clear();
+                        }
+                        globalOffset++;
+                        outLevel.count++;
+                    }
+                    input.remap[input.currentIndex] = static_cast<uint32_t>(globalOffset - 1);
 
-                // update aabb pointers
-                auto aabbVec = reinterpret_cast<VoxelAABB *>(aabbRaw.data());
-                for (uint32_t j = 0; j < numAABB; j++) {
-                    auto &aabb = aabbVec[j];
-                    aabb.lod = dagRoot[j];
+                    if (input.next()) {
+                        std::push_heap(heap.begin(), heap.end(), greater);
+                    } else {
+                        heap.pop_back();
+                    }
                 }
 
-                std::cout << "[" << filename << "] DAG built." << std::endl;
+                std::cout << "[SVDAG] Merged level " << l << ": " << outLevel.count << " nodes." << std::endl;
+            }
+            outLOD.write(reinterpret_cast<char *>(outBuffer.data()), static_cast<std::streamsize>(outBuffer.size() * sizeof(DAG::DAGNode)));
+            writeDAGLevels(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/lod_data/" + name + ".bin", outDAGLevels, DAG::SORT_ORDER_LEXICOGRAPHIC);
 
-                std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
-                double cpuTime = (static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) * std::pow(10, -3));
-                totalTime += cpuTime;
-                std::cout << "[SVDAG] " << cpuTime << "[ms]" << std::endl;
+            // write
+            for (uint64_t vol = 0; vol < dagFileInfos.size(); vol++) {
+                const auto &dagFileInfo = dagFileInfos[vol];
 
-                // write
-                std::ofstream(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/aabb/" + m_prefix + std::to_string(typeId) + ".bin", std::ios::binary)
-                        .write(aabbRaw.data(), static_cast<std::streamsize>(numAABB * sizeof(VoxelAABB)));
-                std::ofstream(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/lod/" + m_prefix + std::to_string(typeId) + ".bin", std::ios::binary)
-                        .write(reinterpret_cast<char *>(dag.data()), static_cast<std::streamsize>(outDAGCount * sizeof(DAG::DAGNode)));
-                std::ofstream(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/lod_data/" + m_prefix + std::to_string(typeId) + ".bin", std::ios::binary)
-                        .write(reinterpret_cast<char *>(outDAGLevels.data()), static_cast<std::streamsize>(outDAGLevels.size() * sizeof(DAG::DAGLevel)));
+                for (const auto &aabbFile: dagFileInfo.m_aabbs) {
+                    uint64_t bytesAABB = std::filesystem::file_size(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/aabb/" + aabbFile + ".bin");
+                    uint64_t bytesPerAABB = sizeof(VoxelAABB);
+                    uint64_t numAABB = bytesAABB / bytesPerAABB;
+                    std::vector<VoxelAABB> inAABB(numAABB);
+                    std::ifstream(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/aabb/" + aabbFile + ".bin", std::ios::binary).read(reinterpret_cast<char *>(inAABB.data()), static_cast<std::streamsize>(bytesAABB));
 
-                std::cout << "Processed " << ++types << "." << std::endl;
+                    for (uint64_t i = 0; i < numAABB; i++) {
+                        inAABB[i].lod = inAABB[i].lod == DAG::invalidPointer() ? DAG::invalidPointer() : inputs[vol].remap[inAABB[i].lod];
+                    }
+
+                    std::ofstream(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/aabb/" + aabbFile + ".bin", std::ios::binary).write(reinterpret_cast<char *>(inAABB.data()), static_cast<std::streamsize>(bytesAABB));
+                }
             }
 
-            std::cout << "[SVDAG] Total time: " << totalTime << "[ms]" << std::endl;
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+            double cpuTime = (static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) * std::pow(10, -3));
+            std::cout << "[SVDAG] Merged from " << inDAGCount << " to " << globalOffset << " nodes." << std::endl;
+            std::cout << "[SVDAG] " << cpuTime << "[ms]" << std::endl;
         }
 
-        struct DAGFileInfo {
-            std::string m_folder;
+        /**
+         * Merges the SVDAGs with DAGExternalReduce, memory is bounded by the external merge memory cap and the merged SVDAG is in lexicographic order.
+         */
+        void mergeDAGsExternal(const std::vector<DAGFileInfo> &dagFileInfos, const std::string &name) const {
+            const std::string merged = m_data + "/" + m_scene + "/" + stringSVDAG(true);
+            std::filesystem::create_directories(merged + "/aabb");
+            std::filesystem::create_directories(merged + "/lod");
+            std::filesystem::create_directories(merged + "/lod_data");
 
-            std::vector<std::string> m_aabbs;
-            std::string m_lod;
-            std::string m_lodData;
+            std::vector<DAGExternalReduce::Input> inputs(dagFileInfos.size());
+            for (uint64_t vol = 0; vol < dagFileInfos.size(); vol++) {
+                const auto &dagFileInfo = dagFileInfos[vol];
+                inputs[vol].m_lod = m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/lod/" + dagFileInfo.m_lod + ".bin";
+                readDAGLevels(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/lod_data/" + dagFileInfo.m_lodData + ".bin", inputs[vol].m_levels);
+            }
 
-            [[nodiscard]] bool exists(const std::string &data, const std::string &scene) const {
-                for (const auto &aabb: m_aabbs) {
-                    if (!std::filesystem::exists(data + "/" + scene + "/" + m_folder + "/aabb/" + aabb + ".bin")) {
-                        return false;
+            DAGExternalReduce externalReduce(merged + "/tmp", m_externalMergeMemoryCap);
+            std::vector<DAG::DAGLevel> outDAGLevels;
+            std::cout << "[SVDAG] Start external reduce." << std::endl;
+            externalReduce.reduce(inputs, merged + "/lod/" + name + ".bin", outDAGLevels);
+            std::cout << "[SVDAG] End external reduce." << std::endl;
+            writeDAGLevels(merged + "/lod_data/" + name + ".bin", outDAGLevels, DAG::SORT_ORDER_LEXICOGRAPHIC);
+
+            for (uint64_t vol = 0; vol < dagFileInfos.size(); vol++) {
+                const auto &dagFileInfo = dagFileInfos[vol];
+                for (const auto &aabbFile: dagFileInfo.m_aabbs) {
+                    std::vector<VoxelAABB> aabbs(std::filesystem::file_size(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/aabb/" + aabbFile + ".bin") / sizeof(VoxelAABB));
+                    std::ifstream(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/aabb/" + aabbFile + ".bin", std::ios::binary).read(reinterpret_cast<char *>(aabbs.data()), static_cast<std::streamsize>(aabbs.size() * sizeof(VoxelAABB)));
+                    for (auto &aabb: aabbs) {
+                        aabb.lod = externalReduce.remap(vol, aabb.lod);
                     }
+                    std::ofstream(merged + "/aabb/" + aabbFile + ".bin", std::ios::binary).write(reinterpret_cast<char *>(aabbs.data()), static_cast<std::streamsize>(aabbs.size() * sizeof(VoxelAABB)));
                 }
-                return std::filesystem::exists(data + "/" + scene + "/" + m_folder + "/lod/" + m_lod + ".bin") &&
-                       std::filesystem::exists(data + "/" + scene + "/" + m_folder + "/lod_data/" + m_lodData + ".bin");
             }
-        };
+        }
+
+        /**
+         * Appends labels to the existing merged SVDAG instead of merging all labels again. The work is proportional to the appended labels:
+         * - the merged lod and the files of writeDAGAppendIndex are memory mapped, only the pages of the touched nodes are read and written
+         * - nodes of the new labels are looked up by binary search in the lexicographic order of their level (lod_index), nodes that are not found are placed
+         *   into free slots of their level, i.e. slots of dropped nodes (lod_free) or the unused slots at the end of the level, and inserted into lod_index
+         * - an appended label replaces the merged AABBs of the same name, nodes that are no longer referenced by a node or an AABB (lod_refs) are dropped
+         *   and their slots are freed
+         * - only if a level runs out of free slots, the levels are laid out again with 1/8 free slots (growDAGLevels), which shifts the higher levels and
+         *   rewrites the AABB files whose roots moved
+         */
+        void appendDAGs(const std::vector<DAGFileInfo> &dagFileInfos) const {
+            const std::string merged = m_data + "/" + m_scene + "/" + stringSVDAG(true);
+            if (!std::filesystem::exists(merged + "/lod/" + m_prefixPlural + ".bin")) {
+                throw std::runtime_error("No merged SVDAG " + m_prefixPlural + " to append to, segmented SVDAGs are merged again with mergeDAGs.");
+            }
+
+            const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
 
-        void mergeDAGs(const std::vector<DAGFileInfo> &dagFileInfos) const {
-            std::vector<DAG::DAGRoot> dagRoot;
-            std::vector<DAG::DAGNode> dag;
             std::vector<DAG::DAGLevel> dagLevels;
+            if (readDAGLevels(merged + "/lod_data/" + m_prefixPlural + ".bin", dagLevels) != DAG::SORT_ORDER_INDEXED) {
+                std::cout << "[SVDAG] Merged SVDAG has no append index, writing it." << std::endl;
+                writeDAGAppendIndex(m_prefixPlural);
+                readDAGLevels(merged + "/lod_data/" + m_prefixPlural + ".bin", dagLevels);
+            }
 
-            loadDAGsCombine(m_data, m_scene, dagFileInfos, dagRoot, dag, dagLevels);
+            // appended labels
+            std::vector<std::vector<DAG::DAGNode>> inDAG(dagFileInfos.size());
+            std::vector<std::vector<DAG::DAGLevel>> inDAGLevels(dagFileInfos.size());
+            std::vector<std::vector<uint32_t>> remap(dagFileInfos.size()); // input node index -> merged node index, provisional for added nodes
+            uint64_t numLevels = dagLevels.size();
+            for (uint64_t vol = 0; vol < dagFileInfos.size(); vol++) {
+                const auto &dagFileInfo = dagFileInfos[vol];
+                readDAGLevels(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/lod_data/" + dagFileInfo.m_lodData + ".bin", inDAGLevels[vol]);
+                const uint64_t bytesLOD = std::filesystem::file_size(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/lod/" + dagFileInfo.m_lod + ".bin");
+                inDAG[vol].resize(bytesLOD / sizeof(DAG::DAGNode));
+                std::ifstream(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/lod/" + dagFileInfo.m_lod + ".bin", std::ios::binary).read(reinterpret_cast<char *>(inDAG[vol].data()), static_cast<std::streamsize>(bytesLOD));
+                remap[vol].assign(inDAG[vol].size(), DAG::invalidPointer());
+                numLevels = glm::max(numLevels, static_cast<uint64_t>(inDAGLevels[vol].size()));
+            }
 
-            DAG dagConstruct(dagRoot.data(), dagRoot.size(), dag.data(), dag.size(), dagLevels);
-            std::cout << "[SVDAG] Start verification." << std::endl;
-            dagConstruct.verify();
-            std::cout << "[SVDAG] End verification." << std::endl;
+            MappedFile lod;
+            MappedFile lookup;
+            MappedFile refs;
+            std::vector<uint32_t> freeSlots;
+            std::vector<uint32_t> used; // used slots of every level, the length of its run in lod_index
+            const auto openMerged = [&]() {
+                lod.open(merged + "/lod/" + m_prefixPlural + ".bin");
+                lookup.open(merged + "/lod_index/" + m_prefixPlural + ".bin");
+                refs.open(merged + "/lod_refs/" + m_prefixPlural + ".bin");
+                if (lookup.sizeBytes() / sizeof(uint32_t) != lod.sizeBytes() / sizeof(DAG::DAGNode) || refs.sizeBytes() != lookup.sizeBytes()) {
+                    throw std::runtime_error("Append index of the merged SVDAG " + m_prefixPlural + " does not match its nodes.");
+                }
+                freeSlots = readDAGFreeSlots(merged + "/lod_free/" + m_prefixPlural + ".bin");
+                used.resize(dagLevels.size());
+                for (uint32_t l = 0; l < dagLevels.size(); l++) {
+                    const uint32_t *run = lookup.data<uint32_t>() + dagLevels[l].index;
+                    used[l] = static_cast<uint32_t>(std::partition_point(run, run + dagLevels[l].count, [](const uint32_t index) { return index != DAG::invalidPointer(); }) - run);
+                }
+            };
+            // free slots of level l: [first, last) of freeSlots, followed by the slots behind its last used slot
+            const auto levelFreeSlots = [&freeSlots, &dagLevels](const uint32_t l) {
+                return std::make_pair(std::lower_bound(freeSlots.begin(), freeSlots.end(), dagLevels[l].index) - freeSlots.begin(),
+                                      std::lower_bound(freeSlots.begin(), freeSlots.end(), dagLevels[l].index + dagLevels[l].count) - freeSlots.begin());
+            };
+            openMerged();
+            const uint64_t numSlots = lod.sizeBytes() / sizeof(DAG::DAGNode);
+
+            // bottom up, nodes that are not in the merged SVDAG get the provisional pointers numSlots, numSlots + 1, ... until all levels are placed
+            std::vector<std::vector<DAG::DAGNode>> added(numLevels);
+            uint64_t numAdded = 0;
+            for (uint32_t l = 0; l < numLevels; l++) {
+                const DAG::DAGNode *nodes = lod.data<DAG::DAGNode>();
+                const uint32_t *run = l < dagLevels.size() ? lookup.data<uint32_t>() + dagLevels[l].index : nullptr;
+                const uint32_t runLength = l < dagLevels.size() ? used[l] : 0;
+
+                std::unordered_map<DAG::DAGNode, uint32_t, DAGNodeHash, DAGNodeEqual> addedIndex;
+                for (uint64_t vol = 0; vol < dagFileInfos.size(); vol++) {
+                    if (l >= inDAGLevels[vol].size()) {
+                        continue;
+                    }
+                    const auto &inLevel = inDAGLevels[vol][l];
+                    for (uint32_t i = inLevel.index; i < inLevel.index + inLevel.count; i++) {
+                        DAG::DAGNode node = inDAG[vol][i];
+                        bool existingChildren = true;
+                        if (!node.isLeaf()) {
+                            node.child0 = remap[vol][node.child0];
+                            node.child1 = remap[vol][node.child1];
+                            node.child2 = remap[vol][node.child2];
+                            node.child3 = remap[vol][node.child3];
+                            node.child4 = remap[vol][node.child4];
+                            node.child5 = remap[vol][node.child5];
+                            node.child6 = remap[vol][node.child6];
+                            node.child7 = remap[vol][node.child7];
+                            existingChildren = std::max({node.child0, node.child1, node.child2, node.child3, node.child4, node.child5, node.child6, node.child7}) < numSlots;
+                        }
+
+                        // existing node, a node with an added child cannot exist
+                        if (existingChildren) {
+                            const uint32_t *it = std::lower_bound(run, run + runLength, node, [nodes](const uint32_t a, const DAG::DAGNode &b) { return nodes[a].lexicographicCompare(b); });
+                            if (it != run + runLength && nodes[*it].equals(node)) {
+                                remap[vol][i] = *it;
+                                continue;
+                            }
+                        }
+
+                        // added node
+                        const auto [addedIt, inserted] = addedIndex.try_emplace(node, static_cast<uint32_t>(numSlots + numAdded + added[l].size()));
+                        if (inserted) {
+                            added[l].push_back(node);
+                            if (numSlots + numAdded + added[l].size() >= DAG::invalidPointer()) {
+                                throw std::runtime_error("Appended SVDAG exceeds 32bit node pointers.");
+                            }
+                        }
+                        remap[vol][i] = addedIt->second;
+                    }
+                }
+                numAdded += added[l].size();
+            }
+
+            // lay the levels out again if a level runs out of free slots, existing pointers move by the shift of their level
+            std::vector<uint32_t> capacities(numLevels);
+            bool grow = numLevels > dagLevels.size();
+            for (uint32_t l = 0; l < numLevels; l++) {
+                const uint64_t slots = l < dagLevels.size() ? dagLevels[l].count : 0;
+                const uint64_t free = l < dagLevels.size() ? slots - used[l] : 0;
+                if (added[l].size() > free) {
+                    const uint64_t required = slots + added[l].size() - free;
+                    capacities[l] = static_cast<uint32_t>(std::min<uint64_t>(required + required / 8, DAG::invalidPointer() - 1));
+                    grow = true;
+                } else {
+                    capacities[l] = static_cast<uint32_t>(slots);
+                }
+            }
+            const std::vector<DAG::DAGLevel> previousLevels = dagLevels;
+            std::vector<uint32_t> shifts(dagLevels.size(), 0);
+            if (grow) {
+                lod.close();
+                lookup.close();
+                refs.close();
+                shifts = growDAGLevels(m_prefixPlural, capacities);
+                readDAGLevels(merged + "/lod_data/" + m_prefixPlural + ".bin", dagLevels);
+                openMerged();
+            }
+            DAG::DAGNode *nodes = lod.data<DAG::DAGNode>();
+            uint32_t *lookupData = lookup.data<uint32_t>();
+            uint32_t *refsData = refs.data<uint32_t>();
+
+            // place the added nodes into the free slots of their level, the slots of dropped nodes first
+            std::vector<uint32_t> placement(numAdded);
+            uint64_t provisional = 0;
+            for (uint32_t l = 0; l < numLevels; l++) {
+                const auto [first, last] = levelFreeSlots(l);
+                const uint64_t reused = std::min<uint64_t>(added[l].size(), last - first);
+                std::copy(freeSlots.begin() + first, freeSlots.begin() + first + static_cast<int64_t>(reused), placement.begin() + static_cast<int64_t>(provisional));
+                std::iota(placement.begin() + static_cast<int64_t>(provisional + reused), placement.begin() + static_cast<int64_t>(provisional + added[l].size()),
+                          dagLevels[l].index + used[l] + static_cast<uint32_t>(last - first));
+                freeSlots.erase(freeSlots.begin() + first, freeSlots.begin() + first + static_cast<int64_t>(reused));
+                provisional += added[l].size();
+            }
+            const auto resolve = [&previousLevels, &shifts, &placement, numSlots](const uint32_t pointer) {
+                if (pointer >= numSlots) {
+                    return placement[pointer - numSlots];
+                }
+                const auto level = std::upper_bound(previousLevels.begin(), previousLevels.end(), pointer, [](const uint32_t p, const DAG::DAGLevel &dagLevel) { return p < dagLevel.index; });
+                return pointer + shifts[level - previousLevels.begin() - 1];
+            };
+
+            // write the added nodes, reference their children and insert them into the lexicographic order of their level
+            provisional = 0;
+            for (uint32_t l = 0; l < numLevels; l++) {
+                std::vector<uint32_t> slots(added[l].size());
+                for (uint64_t k = 0; k < added[l].size(); k++) {
+                    DAG::DAGNode node = added[l][k];
+                    if (!node.isLeaf()) {
+                        for (uint32_t *child: {&node.child0, &node.child1, &node.child2, &node.child3, &node.child4, &node.child5, &node.child6, &node.child7}) {
+                            *child = resolve(*child);
+                            refsData[*child]++;
+                        }
+                    }
+                    slots[k] = placement[provisional + k];
+                    nodes[slots[k]] = node;
+                    refsData[slots[k]] = 0;
+                }
+                provisional += added[l].size();
+
+                // merge from the back, the run has room for the added nodes
+                std::sort(slots.begin(), slots.end(), [nodes](const uint32_t a, const uint32_t b) { return nodes[a].lexicographicCompare(nodes[b]); });
+                uint32_t *run = lookupData + dagLevels[l].index;
+                int64_t i = static_cast<int64_t>(used[l]) - 1;
+                int64_t j = static_cast<int64_t>(slots.size()) - 1;
+                int64_t out = i + j + 1;
+                while (j >= 0) {
+                    if (i >= 0 && nodes[slots[j]].lexicographicCompare(nodes[run[i]])) {
+                        run[out--] = run[i--];
+                    } else {
+                        run[out--] = slots[j--];
+                    }
+                }
+                used[l] += static_cast<uint32_t>(slots.size());
+                if (!added[l].empty()) {
+                    std::cout << "[SVDAG] Appended level " << l << ": " << added[l].size() << " of " << used[l] << " nodes added." << std::endl;
+                }
+            }
+
+            // roots of the appended labels, the roots of the labels they replace are released afterwards
+            std::vector<uint32_t> released;
+            std::vector<std::pair<std::string, std::vector<VoxelAABB>>> appendedAABBs;
+            for (uint64_t vol = 0; vol < dagFileInfos.size(); vol++) {
+                const auto &dagFileInfo = dagFileInfos[vol];
+                for (const auto &aabbFile: dagFileInfo.m_aabbs) {
+                    std::vector<VoxelAABB> aabbs(std::filesystem::file_size(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/aabb/" + aabbFile + ".bin") / sizeof(VoxelAABB));
+                    std::ifstream(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/aabb/" + aabbFile + ".bin", std::ios::binary).read(reinterpret_cast<char *>(aabbs.data()), static_cast<std::streamsize>(aabbs.size() * sizeof(VoxelAABB)));
+                    for (auto &aabb: aabbs) {
+                        if (aabb.lod != DAG::invalidPointer()) {
+                            aabb.lod = resolve(remap[vol][aabb.lod]);
+                            refsData[aabb.lod]++;
+                        }
+                    }
+                    appendedAABBs.emplace_back(aabbFile, std::move(aabbs));
+
+                    if (std::filesystem::exists(merged + "/aabb/" + aabbFile + ".bin")) {
+                        std::vector<VoxelAABB> previousAABBs(std::filesystem::file_size(merged + "/aabb/" + aabbFile + ".bin") / sizeof(VoxelAABB));
+                        std::ifstream(merged + "/aabb/" + aabbFile + ".bin", std::ios::binary).read(reinterpret_cast<char *>(previousAABBs.data()), static_cast<std::streamsize>(previousAABBs.size() * sizeof(VoxelAABB)));
+                        for (const auto &aabb: previousAABBs) {
+                            if (aabb.lod != DAG::invalidPointer()) {
+                                released.push_back(aabb.lod);
+                            }
+                        }
+                    }
+                }
+            }
+
+            // drop the nodes that are no longer referenced, top down
+            std::vector<std::vector<uint32_t>> dropped(numLevels);
+            while (!released.empty()) {
+                const uint32_t index = released.back();
+                released.pop_back();
+                if (refsData[index] == 0) {
+                    throw std::runtime_error("Append index of the merged SVDAG " + m_prefixPlural + " is inconsistent, node " + std::to_string(index) + " is not referenced.");
+                }
+                if (--refsData[index] > 0) {
+                    continue;
+                }
+                const DAG::DAGNode node = nodes[index];
+                const auto level = std::upper_bound(dagLevels.begin(), dagLevels.end(), index, [](const uint32_t p, const DAG::DAGLevel &dagLevel) { return p < dagLevel.index; });
+                dropped[level - dagLevels.begin() - 1].push_back(index);
+                if (!node.isLeaf()) {
+                    released.insert(released.end(), {node.child0, node.child1, node.child2, node.child3, node.child4, node.child5, node.child6, node.child7});
+                }
+            }
+            uint64_t numDropped = 0;
+            for (uint32_t l = 0; l < numLevels; l++) {
+                if (dropped[l].empty()) {
+                    continue;
+                }
+                uint32_t *run = lookupData + dagLevels[l].index;
+                std::vector<uint32_t> positions;
+                for (const uint32_t index: dropped[l]) {
+                    positions.push_back(static_cast<uint32_t>(std::lower_bound(run, run + used[l], nodes[index], [nodes](const uint32_t a, const DAG::DAGNode &b) { return nodes[a].lexicographicCompare(b); }) - run));
+                    if (run[positions.back()] != index) {
+                        throw std::runtime_error("Append index of the merged SVDAG " + m_prefixPlural + " is inconsistent, node " + std::to_string(index) + " is not in lod_index.");
+                    }
+                }
+                std::sort(positions.begin(), positions.end());
+                uint32_t write = positions.front();
+                for (uint32_t read = positions.front(), p = 0; read < used[l]; read++) {
+                    if (p < positions.size() && positions[p] == read) {
+                        p++;
+                        continue;
+                    }
+                    run[write++] = run[read];
+                }
+                std::fill(run + write, run + used[l], DAG::invalidPointer());
+                used[l] = write;
+
+                for (const uint32_t index: dropped[l]) {
+                    nodes[index] = freeDAGSlot();
+                }
+                std::sort(dropped[l].begin(), dropped[l].end());
+                const auto [first, last] = levelFreeSlots(l);
+                std::vector<uint32_t> levelFree(dropped[l].size() + (last - first));
+                std::merge(freeSlots.begin() + first, freeSlots.begin() + last, dropped[l].begin(), dropped[l].end(), levelFree.begin());
+                freeSlots.erase(freeSlots.begin() + first, freeSlots.begin() + last);
+                freeSlots.insert(freeSlots.begin() + first, levelFree.begin(), levelFree.end());
+                numDropped += dropped[l].size();
+                std::cout << "[SVDAG] Appended level " << l << ": " << dropped[l].size() << " nodes of replaced labels dropped." << std::endl;
+            }
+
+            // free slots behind the last used slot of a level are not listed
+            for (uint32_t l = 0; l < dagLevels.size(); l++) {
+                const auto [first, last] = levelFreeSlots(l);
+                int64_t end = last;
+                while (end > first && freeSlots[end - 1] == dagLevels[l].index + used[l] + static_cast<uint32_t>(end - first) - 1) {
+                    end--;
+                }
+                freeSlots.erase(freeSlots.begin() + end, freeSlots.begin() + last);
+            }
+            writeDAGFreeSlots(merged + "/lod_free/" + m_prefixPlural + ".bin", freeSlots);
+
+            for (const auto &[aabbFile, aabbs]: appendedAABBs) {
+                std::ofstream(merged + "/aabb/" + aabbFile + ".bin", std::ios::binary).write(reinterpret_cast<const char *>(aabbs.data()), static_cast<std::streamsize>(aabbs.size() * sizeof(VoxelAABB)));
+            }
+
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+            double cpuTime = (static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) * std::pow(10, -3));
+            std::cout << "[SVDAG] Appended " << dagFileInfos.size() << " SVDAG(s), " << numAdded << " nodes added, " << numDropped << " nodes dropped, "
+                      << std::accumulate(used.begin(), used.end(), UINT64_C(0)) << " of " << lod.sizeBytes() / sizeof(DAG::DAGNode) << " slots used." << std::endl;
+            std::cout << "[SVDAG] " << cpuTime << "[ms]" << std::endl;
+        }
+
+        /**
+         * Writes the files that appendDAGs keeps up to date for the merged SVDAG <name> and marks its levels SORT_ORDER_INDEXED:
+         * - lod_index: per level the used slots in lexicographic order, followed by DAG::invalidPointer() for the free slots of the level
+         * - lod_refs: per slot the number of references by the nodes of the level above and by the AABBs in the merged aabb folder
+         * - lod_free: the sorted free slots that are followed by a used slot of their level, i.e. slots of nodes dropped by appendDAGs
+         * With setAppendReserve, the levels are laid out with the given fraction of free slots (growDAGLevels), such that appending does not shift them.
+         */
+        void writeDAGAppendIndex(const std::string &name) const {
+            const std::string merged = m_data + "/" + m_scene + "/" + stringSVDAG(true);
+            std::vector<DAG::DAGLevel> dagLevels;
+            const DAG::SortOrder sortOrder = readDAGLevels(merged + "/lod_data/" + name + ".bin", dagLevels);
+            if (sortOrder == DAG::SORT_ORDER_INDEXED) {
+                throw std::runtime_error("Merged SVDAG " + name + " already has an append index.");
+            }
+            std::filesystem::create_directories(merged + "/lod_index");
+            std::filesystem::create_directories(merged + "/lod_refs");
+            std::filesystem::create_directories(merged + "/lod_free");
+
+            MappedFile lod;
+            lod.open(merged + "/lod/" + name + ".bin");
+            const DAG::DAGNode *nodes = lod.data<DAG::DAGNode>();
+            const uint64_t numSlots = lod.sizeBytes() / sizeof(DAG::DAGNode);
+
+            // a sorted SVDAG is its own lookup
+            MappedFile lookup;
+            lookup.create(merged + "/lod_index/" + name + ".bin", numSlots * sizeof(uint32_t));
+            uint32_t *lookupData = lookup.data<uint32_t>();
+            std::iota(lookupData, lookupData + numSlots, 0);
+            if (sortOrder != DAG::SORT_ORDER_LEXICOGRAPHIC) {
+                for (const auto &level: dagLevels) {
+                    std::sort(std::execution::par_unseq, lookupData + level.index, lookupData + level.index + level.count, [nodes](const uint32_t a, const uint32_t b) { return nodes[a].lexicographicCompare(nodes[b]); });
+                }
+            }
+
+            MappedFile refs;
+            refs.create(merged + "/lod_refs/" + name + ".bin", numSlots * sizeof(uint32_t));
+            uint32_t *refsData = refs.data<uint32_t>();
+            for (uint64_t i = 0; i < numSlots; i++) {
+                const DAG::DAGNode &node = nodes[i];
+                if (!node.isLeaf()) {
+                    for (const uint32_t child: {node.child0, node.child1, node.child2, node.child3, node.child4, node.child5, node.child6, node.child7}) {
+                        refsData[child]++;
+                    }
+                }
+            }
+            for (const auto &type: std::filesystem::directory_iterator(merged + "/aabb")) {
+                std::vector<VoxelAABB> aabbs(std::filesystem::file_size(type.path()) / sizeof(VoxelAABB));
+                std::ifstream(type.path(), std::ios::binary).read(reinterpret_cast<char *>(aabbs.data()), static_cast<std::streamsize>(aabbs.size() * sizeof(VoxelAABB)));
+                for (const auto &aabb: aabbs) {
+                    if (aabb.lod == DAG::invalidPointer()) {
+                        continue;
+                    }
+                    if (aabb.lod >= numSlots) {
+                        throw std::runtime_error("AABB file " + type.path().string() + " does not belong to the merged SVDAG " + name + ".");
+                    }
+                    refsData[aabb.lod]++;
+                }
+            }
+            lod.close();
+            lookup.close();
+            refs.close();
+            writeDAGFreeSlots(merged + "/lod_free/" + name + ".bin", {});
+            writeDAGLevels(merged + "/lod_data/" + name + ".bin", dagLevels, DAG::SORT_ORDER_INDEXED);
+
+            if (m_appendReserve > 0.0) {
+                std::vector<uint32_t> capacities(dagLevels.size());
+                for (uint32_t l = 0; l < dagLevels.size(); l++) {
+                    capacities[l] = static_cast<uint32_t>(std::min<double>(std::ceil(dagLevels[l].count * (1.0 + m_appendReserve)), DAG::invalidPointer() - 1));
+                }
+                growDAGLevels(name, capacities);
+            }
+        }
+
+        /**
+         * Lays the levels of the merged SVDAG <name> out with the given number of slots per level, at least the current ones. Additional levels start empty.
+         * The slots added at the end of a level are free. Pointers into moved levels are shifted in lod, lod_index, lod_free and the AABB files in the merged
+         * aabb folder, AABB files without moved roots are not rewritten. Returns the shift of every previous level.
+         */
+        std::vector<uint32_t> growDAGLevels(const std::string &name, const std::vector<uint32_t> &capacities) const {
+            const std::string merged = m_data + "/" + m_scene + "/" + stringSVDAG(true);
+            std::vector<DAG::DAGLevel> dagLevels;
+            if (readDAGLevels(merged + "/lod_data/" + name + ".bin", dagLevels) != DAG::SORT_ORDER_INDEXED) {
+                throw std::runtime_error("Merged SVDAG " + name + " has no append index.");
+            }
+            if (capacities.size() < dagLevels.size()) {
+                throw std::runtime_error("Merged SVDAG levels cannot be removed.");
+            }
+
+            std::vector<DAG::DAGLevel> outDAGLevels(capacities.size());
+            std::vector<uint32_t> shifts(dagLevels.size());
+            uint64_t numOutSlots = 0;
+            for (uint32_t l = 0; l < capacities.size(); l++) {
+                if (l < dagLevels.size() && capacities[l] < dagLevels[l].count) {
+                    throw std::runtime_error("Merged SVDAG levels cannot shrink.");
+                }
+                outDAGLevels[l] = {static_cast<uint32_t>(numOutSlots), capacities[l]};
+                if (l < dagLevels.size()) {
+                    shifts[l] = outDAGLevels[l].index - dagLevels[l].index;
+                }
+                numOutSlots += capacities[l];
+                if (numOutSlots >= DAG::invalidPointer()) {
+                    throw std::runtime_error("Merged SVDAG exceeds 32bit node pointers.");
+                }
+            }
+            const auto shiftPointer = [&dagLevels, &shifts](const uint32_t pointer) {
+                const auto level = std::upper_bound(dagLevels.begin(), dagLevels.end(), pointer, [](const uint32_t p, const DAG::DAGLevel &dagLevel) { return p < dagLevel.index; });
+                return pointer + shifts[level - dagLevels.begin() - 1];
+            };
 
-            std::cout << "[SVDAG] Start reduce." << std::endl;
-            uint32_t outDAGCount;
-            std::vector<DAG::DAGLevel> outDAGLevels(dagLevels.size());
-            dagConstruct.reduce(&outDAGCount, outDAGLevels);
-            std::cout << "[SVDAG] End reduce." << std::endl;
+            {
+                MappedFile lod;
+                MappedFile lookup;
+                MappedFile refs;
+                lod.open(merged + "/lod/" + name + ".bin");
+                lookup.open(merged + "/lod_index/" + name + ".bin");
+                refs.open(merged + "/lod_refs/" + name + ".bin");
+                MappedFile outLOD;
+                MappedFile outLookup;
+                MappedFile outRefs;
+                outLOD.create(merged + "/lod/" + name + ".bin.tmp", numOutSlots * sizeof(DAG::DAGNode));
+                outLookup.create(merged + "/lod_index/" + name + ".bin.tmp", numOutSlots * sizeof(uint32_t));
+                outRefs.create(merged + "/lod_refs/" + name + ".bin.tmp", numOutSlots * sizeof(uint32_t));
+                for (uint32_t l = 0; l < outDAGLevels.size(); l++) {
+                    const DAG::DAGLevel level = l < dagLevels.size() ? dagLevels[l] : DAG::DAGLevel{0, 0};
+                    const DAG::DAGLevel &outLevel = outDAGLevels[l];
+                    DAG::DAGNode *outNodes = outLOD.data<DAG::DAGNode>() + outLevel.index;
+                    uint32_t *outRun = outLookup.data<uint32_t>() + outLevel.index;
+                    for (uint32_t i = 0; i < level.count; i++) {
+                        DAG::DAGNode node = lod.data<DAG::DAGNode>()[level.index + i];
+                        if (!node.isLeaf()) {
+                            for (uint32_t *child: {&node.child0, &node.child1, &node.child2, &node.child3, &node.child4, &node.child5, &node.child6, &node.child7}) {
+                                *child = shiftPointer(*child);
+                            }
+                        }
+                        outNodes[i] = node;
+                        const uint32_t index = lookup.data<uint32_t>()[level.index + i];
+                        outRun[i] = index == DAG::invalidPointer() ? DAG::invalidPointer() : index + shifts[l];
+                    }
+                    std::fill(outNodes + level.count, outNodes + outLevel.count, freeDAGSlot());
+                    std::fill(outRun + level.count, outRun + outLevel.count, DAG::invalidPointer());
+                    std::copy(refs.data<uint32_t>() + level.index, refs.data<uint32_t>() + level.index + level.count, outRefs.data<uint32_t>() + outLevel.index);
+                }
+            }
+            for (const char *folder: {"/lod/", "/lod_index/", "/lod_refs/"}) {
+                std::filesystem::rename(merged + folder + name + ".bin.tmp", merged + folder + name + ".bin");
+            }
 
-            std::cout << "[SVDAG] Start verification." << std::endl;
-            DAG dagVerify(dagRoot.data(), dagRoot.size(), dag.data(), outDAGCount, outDAGLevels);
-            dagVerify.verify();
-            std::cout << "[SVDAG] End verification." << std::endl;
+            std::vector<uint32_t> freeSlots = readDAGFreeSlots(merged + "/lod_free/" + name + ".bin");
+            for (auto &index: freeSlots) {
+                index = shiftPointer(index);
+            }
+            writeDAGFreeSlots(merged + "/lod_free/" + name + ".bin", freeSlots);
+            writeDAGLevels(merged + "/lod_data/" + name + ".bin", outDAGLevels, DAG::SORT_ORDER_INDEXED);
+
+            uint64_t numAABBFiles = 0;
+            for (const auto &type: std::filesystem::directory_iterator(merged + "/aabb")) {
+                std::vector<VoxelAABB> aabbs(std::filesystem::file_size(type.path()) / sizeof(VoxelAABB));
+                std::ifstream(type.path(), std::ios::binary).read(reinterpret_cast<char *>(aabbs.data()), static_cast<std::streamsize>(aabbs.size() * sizeof(VoxelAABB)));
+                bool moved = false;
+                for (auto &aabb: aabbs) {
+                    if (aabb.lod != DAG::invalidPointer() && shiftPointer(aabb.lod) != aabb.lod) {
+                        aabb.lod = shiftPointer(aabb.lod);
+                        moved = true;
+                    }
+                }
+                if (moved) {
+                    std::ofstream(type.path(), std::ios::binary).write(reinterpret_cast<char *>(aabbs.data()), static_cast<std::streamsize>(aabbs.size() * sizeof(VoxelAABB)));
+                    numAABBFiles++;
+                }
+            }
+            std::cout << "[SVDAG] Laid out the merged SVDAG " << name << " with " << numOutSlots << " slots, " << numAABBFiles << " AABB files with moved roots rewritten." << std::endl;
+            return shifts;
+        }
 
-            // write
-            std::filesystem::create_directories(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/aabb");
-            std::filesystem::create_directories(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/lod");
-            std::filesystem::create_directories(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/lod_data");
+        // placeholder of a free slot in a merged SVDAG, an empty leaf that no node or AABB points to
+        static DAG::DAGNode freeDAGSlot() {
+            return DAG::DAGNode{DAG::invalidPointer(), 0, 0};
+        }
 
-            uint64_t c = 0;
-            for (uint64_t vol = 0; vol < dagFileInfos.size(); vol++) {
-                const auto &dagFileInfo = dagFileInfos[vol];
+        static std::vector<uint32_t> readDAGFreeSlots(const std::string &path) {
+            std::vector<uint32_t> freeSlots(std::filesystem::file_size(path) / sizeof(uint32_t));
+            std::ifstream(path, std::ios::binary).read(reinterpret_cast<char *>(freeSlots.data()), static_cast<std::streamsize>(freeSlots.size() * sizeof(uint32_t)));
+            return freeSlots;
+        }
 
-                for (uint64_t aabb = 0; aabb < dagFileInfo.m_aabbs.size(); aabb++) {
-                    const auto &aabbFile = dagFileInfo.m_aabbs[aabb];
+        static void writeDAGFreeSlots(const std::string &path, const std::vector<uint32_t> &freeSlots) {
+            std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char *>(freeSlots.data()), static_cast<std::streamsize>(freeSlots.size() * sizeof(uint32_t)));
+        }
 
-                    uint64_t bytesAABB = std::filesystem::file_size(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/aabb/" + aabbFile + ".bin");
-                    uint64_t bytesPerAABB = sizeof(VoxelAABB);
-                    uint64_t numAABB = bytesAABB / bytesPerAABB;
-                    std::vector<VoxelAABB> inAABB(numAABB);
-                    std::ifstream(m_data + "/" + m_scene + "/" + dagFileInfo.m_folder + "/aabb/" + aabbFile + ".bin", std::ios::binary).read(reinterpret_cast<char *>(inAABB.data()), static_cast<std::streamsize>(bytesAABB));
+        // lod_data holds the DAG levels, optionally followed by the trailer {DAG::invalidPointer(), sort order} if the levels are sorted
+        static DAG::SortOrder readDAGLevels(const std::string &path, std::vector<DAG::DAGLevel> &dagLevels) {
+            const uint64_t bytesLODData = std::filesystem::file_size(path);
+            constexpr uint64_t bytesPerLODData = sizeof(DAG::DAGLevel);
+            dagLevels.resize(bytesLODData / bytesPerLODData);
+            std::ifstream(path, std::ios::binary).read(reinterpret_cast<char *>(dagLevels.data()), static_cast<std::streamsize>(dagLevels.size() * bytesPerLODData));
+            if (!dagLevels.empty() && dagLevels.back().index == DAG::invalidPointer()) {
+                const auto sortOrder = static_cast<DAG::SortOrder>(dagLevels.back().count);
+                dagLevels.pop_back();
+                return sortOrder;
+            }
+            return DAG::SORT_ORDER_NONE;
+        }
 
-                    for (uint64_t i = 0; i < numAABB; i++) {
-                        inAABB[i].lod = dagRoot[c];
-                        c++;
-                    }
+        static void writeDAGLevels(const std::string &path, const std::vector<DAG::DAGLevel> &dagLevels, const DAG::SortOrder sortOrder) {
+            std::ofstream file(path, std::ios::binary);
+            file.write(reinterpret_cast<const char *>(dagLevels.data()), static_cast<std::streamsize>(dagLevels.size() * sizeof(DAG::DAGLevel)));
+            if (sortOrder != DAG::SORT_ORDER_NONE) {
+                const DAG::DAGLevel trailer{DAG::invalidPointer(), sortOrder};
+                file.write(reinterpret_cast<const char *>(&trailer), sizeof(DAG::DAGLevel));
+            }
+        }
 
-                    std::ofstream(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/aabb/" + aabbFile + ".bin", std::ios::binary).write(reinterpret_cast<char *>(inAABB.data()), static_cast<std::streamsize>(bytesAABB));
+        // encodes the SVDAG <folder>/lod/<lod>.bin into <outFolder>/lod/<lod>.bin and remaps the roots of its AABB files into <outFolder>/aabb
+        void compactDAG(const std::string &folder, const std::vector<std::string> &aabbFiles, const std::string &lod, const std::string &outFolder, uint64_t &bytesLOD, uint64_t &bytesCompactLOD) const {
+            const std::string scene = m_data + "/" + m_scene + "/";
+            std::filesystem::create_directories(scene + outFolder + "/aabb");
+            std::filesystem::create_directories(scene + outFolder + "/lod");
+
+            std::vector<DAG::DAGNode> dag(std::filesystem::file_size(scene + folder + "/lod/" + lod + ".bin") / sizeof(DAG::DAGNode));
+            std::ifstream(scene + folder + "/lod/" + lod + ".bin", std::ios::binary).read(reinterpret_cast<char *>(dag.data()), static_cast<std::streamsize>(dag.size() * sizeof(DAG::DAGNode)));
+
+            std::vector<uint32_t> words;
+            std::vector<uint32_t> pointers;
+            DAGCompact::encode(dag, m_compactLeafTable, words, pointers);
+            DAGCompact::verify(dag, words, pointers);
+            std::ofstream(scene + outFolder + "/lod/" + lod + ".bin", std::ios::binary).write(reinterpret_cast<const char *>(words.data()), static_cast<std::streamsize>(words.size() * sizeof(uint32_t)));
+            bytesLOD += dag.size() * sizeof(DAG::DAGNode);
+            bytesCompactLOD += words.size() * sizeof(uint32_t);
+
+            for (const auto &aabbFile: aabbFiles) {
+                std::vector<VoxelAABB> aabbs(std::filesystem::file_size(scene + folder + "/aabb/" + aabbFile + ".bin") / sizeof(VoxelAABB));
+                std::ifstream(scene + folder + "/aabb/" + aabbFile + ".bin", std::ios::binary).read(reinterpret_cast<char *>(aabbs.data()), static_cast<std::streamsize>(aabbs.size() * sizeof(VoxelAABB)));
+                for (auto &aabb: aabbs) {
+                    if (aabb.lod == DAG::invalidPointer()) {
+                        continue;
+                    }
+                    if (aabb.lod >= dag.size()) {
+                        throw std::runtime_error("AABB of " + aabbFile + " points to node " + std::to_string(aabb.lod) + " beyond the " + std::to_string(dag.size()) + " nodes of SVDAG " + lod + ".");
+                    }
+                    aabb.lod = pointers[aabb.lod];
                 }
+                std::ofstream(scene + outFolder + "/aabb/" + aabbFile + ".bin", std::ios::binary).write(reinterpret_cast<const char *>(aabbs.data()), static_cast<std::streamsize>(aabbs.size() * sizeof(VoxelAABB)));
             }
+            std::cout << "[SVDAG] " << outFolder << "/" << lod << ": " << dag.size() << " nodes (" << dag.size() * sizeof(DAG::DAGNode) << " bytes) -> " << words.size() << " words (" << words.size() * sizeof(uint32_t) << " bytes)." << std::endl;
+        }
 
-            std::ofstream(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/lod/" + m_prefixPlural + ".bin", std::ios::binary).write(reinterpret_cast<char *>(dag.data()), static_cast<std::streamsize>(outDAGCount * sizeof(DAG::DAGNode)));
-            std::ofstream(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/lod_data/" + m_prefixPlural + ".bin", std::ios::binary).write(reinterpret_cast<char *>(outDAGLevels.data()), static_cast<std::streamsize>(outDAGLevels.size() * sizeof(DAG::DAGLevel)));
+        // one pool per merge segment (see mergeSegments), the SVDAGs of a segment are combined with 32bit pointers
+        static std::vector<DAGPool> loadDAGsCombine(const std::string &data, const std::string &scene, const std::vector<std::vector<DAGFileInfo>> &segments) {
+            std::vector<DAGPool> pools(segments.size());
+            for (uint64_t segment = 0; segment < segments.size(); segment++) {
+                loadDAGsCombine(data, scene, segments[segment], pools[segment].m_dagRoot, pools[segment].m_dag, pools[segment].m_dagLevels);
+            }
+            return pools;
         }
 
         static void loadDAGsCombine(const std::string &data, const std::string &scene, const std::vector<DAGFileInfo> &dagFileInfos,
@@ -293,6 +1118,7 @@ namespace raven {
             uint64_t totalNumAABB = 0;
             uint64_t totalNumLOD = 0;
             std::vector<uint64_t> inNumDagLevels;
+            std::vector<std::vector<DAG::DAGLevel>> inDAGLevels; // from input
 
             for (const auto &dagFileInfo: dagFileInfos) {
                 for (const auto &file: dagFileInfo.m_aabbs) {
@@ -304,25 +1130,21 @@ namespace raven {
                 const uint64_t bytesLOD = std::filesystem::file_size(data + "/" + scene + "/" + dagFileInfo.m_folder + "/lod/" + dagFileInfo.m_lod + ".bin");
                 constexpr uint64_t bytesPerLOD = sizeof(DAG::DAGNode);
                 totalNumLOD += bytesLOD / bytesPerLOD;
+                if (totalNumLOD > DAG::invalidPointer()) {
+                    throw std::runtime_error("Combined SVDAG exceeds 32bit node pointers, combine the labels per merge segment (see mergeSegments).");
+                }
 
-                const uint64_t bytesLODData = std::filesystem::file_size(data + "/" + scene + "/" + dagFileInfo.m_folder + "/lod_data/" + dagFileInfo.m_lodData + ".bin");
-                constexpr uint64_t bytesPerLODData = sizeof(DAG::DAGLevel);
-                inNumDagLevels.push_back(bytesLODData / bytesPerLODData);
+                // load DAG levels (lod_data)
+                inDAGLevels.emplace_back();
+                readDAGLevels(data + "/" + scene + "/" + dagFileInfo.m_folder + "/lod_data/" + dagFileInfo.m_lodData + ".bin", inDAGLevels.back());
+                inNumDagLevels.push_back(inDAGLevels.back().size());
             }
 
-            // load DAG levels (lod_data)
-            std::vector<std::vector<DAG::DAGLevel>> inDAGLevels;                          // from input
             std::vector<std::vector<DAG::DAGLevel>> offsetDAGLevels(dagFileInfos.size()); // offset when combining
             uint64_t numLevels = 0;
             {
-                for (const auto &dagFileInfo: dagFileInfos) {
-                    const uint64_t bytesLODData = std::filesystem::file_size(data + "/" + scene + "/" + dagFileInfo.m_folder + "/lod_data/" + dagFileInfo.m_lodData + ".bin");
-                    constexpr uint64_t bytesPerLODData = sizeof(DAG::DAGLevel);
-                    const uint64_t numLevel = bytesLODData / bytesPerLODData;
+                for (const auto numLevel: inNumDagLevels) {
                     numLevels = glm::max(numLevels, numLevel);
-                    inDAGLevels.emplace_back();
-                    inDAGLevels.back().resize(numLevel);
-                    std::ifstream(data + "/" + scene + "/" + dagFileInfo.m_folder + "/lod_data/" + dagFileInfo.m_lodData + ".bin", std::ios::binary).read(reinterpret_cast<char *>(inDAGLevels.back().data()), static_cast<std::streamsize>(bytesLODData));
                 }
 
                 dagLevels.resize(numLevels);
@@ -442,6 +1264,10 @@ namespace raven {
             return m_stringSVDAG + (m_svdagOccupancyField ? "_" + m_stringSVDAGOccupancyField : "") + (merged ? "_" + m_stringSVDAGMerged : "");
         }
 
+        [[nodiscard]] std::string stringSVDAGCompact(const bool merged) const {
+            return stringSVDAG(merged) + "_" + m_stringSVDAGCompact;
+        }
+
         void nodeInfo() {
             std::ofstream csv;
             csv.open(m_data + "/" + m_scene + "/" + m_scene + "_nodeinfo.txt");
@@ -460,16 +1286,19 @@ namespace raven {
 
                     uint32_t numAABB;
                     {
-                        uint32_t bytesAABB = std::filesystem::file_size(type.path());
-                        uint32_t bytesPerAABB = sizeof(VoxelAABB);
-                        numAABB = bytesAABB / bytesPerAABB;
+                        uint64_t bytesAABB = std::filesystem::file_size(type.path());
+                        uint64_t bytesPerAABB = sizeof(VoxelAABB);
+                        if (bytesAABB / bytesPerAABB > UINT32_MAX) {
+                            throw std::runtime_error("Number of AABBs exceeds 32 bits.");
+                        }
+                        numAABB = static_cast<uint32_t>(bytesAABB / bytesPerAABB);
                         aabbRaw.resize(bytesAABB);
-                        std::ifstream(type.path(), std::ios::binary).read(aabbRaw.data(), bytesAABB);
+                        std::ifstream(type.path(), std::ios::binary).read(aabbRaw.data(), static_cast<std::streamsize>(bytesAABB));
 
                         std::string filename = type.path().filename();
-                        uint32_t bytesLOD = std::filesystem::file_size(m_data + "/" + m_scene + "/" + m_stringSVO + "/lod/" + filename);
+                        uint64_t bytesLOD = std::filesystem::file_size(m_data + "/" + m_scene + "/" + m_stringSVO + "/lod/" + filename);
                         lodRaw.resize(bytesLOD);
-                        std::ifstream(m_data + "/" + m_scene + "/" + m_stringSVO + "/lod/" + filename, std::ios::binary).read(lodRaw.data(), bytesLOD);
+                        std::ifstream(m_data + "/" + m_scene + "/" + m_stringSVO + "/lod/" + filename, std::ios::binary).read(lodRaw.data(), static_cast<std::streamsize>(bytesLOD));
                     }
 
                     // traverse SVO
@@ -519,11 +1348,8 @@ namespace raven {
                 for (const auto &type: std::filesystem::directory_iterator(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/lod_data")) {
                     csv << type.path().filename() << std::endl;
                     std::vector<DAG::DAGLevel> levels;
-                    uint64_t bytesLODData = std::filesystem::file_size(type.path());
-                    uint64_t bytesPerLODData = sizeof(DAG::DAGLevel);
-                    uint64_t numLevel = bytesLODData / bytesPerLODData;
-                    levels.resize(numLevel);
-                    std::ifstream(type.path(), std::ios::binary).read(reinterpret_cast<char *>(levels.data()), static_cast<std::streamsize>(bytesLODData));
+                    readDAGLevels(type.path().string(), levels);
+                    uint64_t numLevel = levels.size();
 
                     uint64_t nodesTotal = 0;
                     for (uint32_t i = 0; i < levels.size(); i++) {
@@ -554,11 +1380,7 @@ namespace raven {
                 csv << "svdag_occupancy_field_merged" << std::endl;
                 csv << "types.bin" << std::endl;
                 std::vector<DAG::DAGLevel> levels;
-                uint64_t bytesLODData = std::filesystem::file_size(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/lod_data/" + m_prefixPlural + ".bin");
-                uint64_t bytesPerLODData = sizeof(DAG::DAGLevel);
-                uint64_t numLevel = bytesLODData / bytesPerLODData;
-                levels.resize(numLevel);
-                std::ifstream(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/lod_data/" + m_prefixPlural + ".bin", std::ios::binary).read(reinterpret_cast<char *>(levels.data()), static_cast<std::streamsize>(bytesLODData));
+                readDAGLevels(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/lod_data/" + m_prefixPlural + ".bin", levels);
 
                 uint64_t nodesTotal = 0;
                 for (uint32_t i = 0; i < levels.size(); i++) {
@@ -607,11 +1429,8 @@ namespace raven {
                     lod.resize(numLOD);
                     std::ifstream(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/lod/" + filename, std::ios::binary).read(reinterpret_cast<char *>(lod.data()), static_cast<std::streamsize>(bytesLOD));
 
-                    uint64_t bytesLODData = std::filesystem::file_size(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/lod_data/" + filename);
-                    uint64_t bytesPerLODData = sizeof(DAG::DAGLevel);
-                    numLevel = bytesLODData / bytesPerLODData;
-                    level.resize(numLevel);
-                    std::ifstream(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/lod_data/" + filename, std::ios::binary).read(reinterpret_cast<char *>(level.data()), static_cast<std::streamsize>(bytesLODData));
+                    readDAGLevels(m_data + "/" + m_scene + "/" + stringSVDAG(true) + "/lod_data/" + filename, level);
+                    numLevel = level.size();
                 }
 
                 std::vector<uint64_t> visits(numLOD, 0);
@@ -688,6 +1507,20 @@ namespace raven {
         std::string m_stringSVDAG = "svdag";
         std::string m_stringSVDAGOccupancyField = "occupancy_field";
         std::string m_stringSVDAGMerged = "merged";
+        std::string m_stringSVDAGCompact = "compact";
+
+        uint32_t m_numThreads = std::max(1u, std::thread::hardware_concurrency());
+        uint64_t m_memoryBudget = UINT64_C(16) << 30; // 16 GiB
+        DAG::ReduceMode m_reduceMode = DAG::REDUCE_MODE_HASH_COMPARATOR;
+        DAGBuilder m_dagBuilder = DAG_BUILDER_REDUCE;
+        uint64_t m_externalMergeMemoryCap = 0;
+        Subdivision m_subdivision = SUBDIVISION_MEDIAN_SPLIT;
+        Octree::Builder m_octreeBuilder = Octree::BUILDER_PARTITION;
+        VoxelWriter::Layout m_voxelLayout = VoxelWriter::LAYOUT_FILE_PER_LABEL;
+        uint64_t m_chunkVoxels = UINT64_C(1) << 28; // voxels of a label that are expanded from its bricks at once, 3 GiB of glm::ivec3
+        uint64_t m_mergeSegmentNodes = DAG::invalidPointer(); // nodes of the merged SVDAG of a segment, see mergeSegments
+        bool m_compactLeafTable = false;                      // DAGCompact leaf table, see compactDAGs
+        double m_appendReserve = 0.0;                         // free slots of the merged levels for appendDAGs, see writeDAGAppendIndex
 
         template<class T>
         static inline void hash_combine(std::size_t &seed, const T &v) {
@@ -699,107 +1532,306 @@ namespace raven {
             std::filesystem::create_directories(m_data + "/" + m_scene + "/" + m_stringVoxels);
         }
 
-        static void insertVoxel(std::map<uint32_t, std::vector<glm::ivec3>> &voxels, uint32_t typeId, const glm::ivec3 offset, const int32_t vx, const int32_t vy, const int32_t vz) {
-            if (voxels.contains(typeId)) {
-                voxels[typeId].emplace_back(offset.x + vx, offset.y + vy, offset.z + vz);
-            } else {
-                voxels.insert({typeId, {{offset.x + vx, offset.y + vy, offset.z + vz}}});
+        // the voxel writer of rawDataToVoxelTypes, it buffers up to 1/16 of the memory budget before the bricks are written
+        [[nodiscard]] VoxelWriter createVoxelWriter() const {
+            return VoxelWriter(m_data + "/" + m_scene + "/" + m_stringVoxels, m_prefix, m_prefixPlural, m_voxelLayout, m_memoryBudget / 16);
+        }
+
+        // hands the voxels of every type as bricks to the writer, the w component of glm::ivec4 voxels is the instance id
+        template<typename V>
+        void writeVoxels(VoxelWriter &writer, std::map<uint32_t, std::vector<V>> &voxels, const bool log = true) const {
+            for (auto &type: voxels) {
+                std::vector<VoxelBricks::Brick> bricks = VoxelBricks::build(std::span<const V>(type.second));
+                if (log) {
+                    std::cout << m_prefix << type.first << " has " << type.second.size() << " voxels in " << bricks.size() << " bricks." << std::endl;
+                }
+                writer.write(type.first, std::move(bricks));
+            }
+        }
+
+        struct DAGBuildArena;
+
+        // voxels of a label: a file of the label (VoxelBricks or legacy) or the extents of the label in a VoxelBricks shard container
+        struct VoxelSource {
+            std::filesystem::directory_entry entry;
+            std::vector<VoxelBricks::ShardExtent> extents; // empty for a file of the label
+
+            [[nodiscard]] bool isBricks() const { return !extents.empty() || VoxelBricks::isBrickFile(entry.path()); }
+        };
+
+        void voxelTypesToAABBsAndLODs(const bool writeSVO, const bool buildSVDAG) const {
+            if (writeSVO) {
+                std::filesystem::create_directories(m_data + "/" + m_scene + "/" + m_stringSVO + "/aabb");
+                std::filesystem::create_directories(m_data + "/" + m_scene + "/" + m_stringSVO + "/lod");
+            }
+            if (buildSVDAG) {
+                std::filesystem::create_directories(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/aabb");
+                std::filesystem::create_directories(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/lod");
+                std::filesystem::create_directories(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/lod_data");
+            }
+            const std::string tag = buildSVDAG ? "SVDAG" : "SVO";
+
+            LabelScheduler scheduler(m_numThreads, m_memoryBudget);
+            std::atomic<uint32_t> types = 0;
+
+            // buffers are reused by all labels processed on the same worker
+            std::vector<DAGBuildArena> arenas(buildSVDAG ? m_numThreads : 0);
+
+            std::vector<LabelScheduler::Job> jobs;
+            const auto addJob = [this, writeSVO, buildSVDAG, &tag, &scheduler, &types, &arenas, &jobs](const VoxelSource &source, const std::string &filename, const uint32_t typeId) {
+                const bool svoExists = std::filesystem::exists(m_data + "/" + m_scene + "/" + m_stringSVO + "/aabb/" + m_prefix + std::to_string(typeId) + ".bin") && std::filesystem::exists(m_data + "/" + m_scene + "/" + m_stringSVO + "/lod/" + m_prefix + std::to_string(typeId) + ".bin");
+                const bool svdagExists = std::filesystem::exists(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/aabb/" + m_prefix + std::to_string(typeId) + ".bin") && std::filesystem::exists(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/lod/" + m_prefix + std::to_string(typeId) + ".bin") && std::filesystem::exists(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/lod_data/" + m_prefix + std::to_string(typeId) + ".bin");
+                if ((!writeSVO || svoExists) && (!buildSVDAG || svdagExists)) {
+                    std::cout << "Skipping " << filename << ". " << tag << " already exists." << std::endl;
+                    return;
+                }
+
+                jobs.push_back({.m_name = filename,
+                                .m_footprint = voxelFootprint(source, buildSVDAG),
+                                .m_work = [this, source, filename, typeId, writeSVO, buildSVDAG, &scheduler, &types, &arenas](const uint32_t worker) {
+                                    voxelTypeToAABBsAndOctree(source, filename, typeId, writeSVO, buildSVDAG ? &arenas[worker] : nullptr, scheduler);
+                                    scheduler.log("Processed " + std::to_string(++types) + ".");
+                                }});
+            };
+            for (const auto &type: std::filesystem::directory_iterator(m_data + "/" + m_scene + "/" + m_stringVoxels)) {
+                if (VoxelBricks::isShardIndexFile(type.path())) {
+                    continue; // read with its container
+                }
+                if (VoxelBricks::isShardFile(type.path())) {
+                    for (auto &[typeId, extents]: VoxelBricks::shardIndex(type.path().string())) {
+                        addJob({.entry = type, .extents = std::move(extents)}, m_prefix + std::to_string(typeId), typeId);
+                    }
+                    continue;
+                }
+                std::string filename = type.path().filename().string();
+                const std::regex rgx("[" + m_prefix + "]?([0-9]+)\\.[bin|idx]");
+                std::smatch matches;
+                std::regex_search(filename, matches, rgx);
+                if (matches.size() != 2) {
+                    std::cout << "Skipping " << filename << "." << std::endl;
+                    continue;
+                }
+                addJob({.entry = type, .extents = {}}, filename, static_cast<uint32_t>(std::stoul(matches[1])));
             }
+
+            std::cout << "[" << tag << "] Processing " << jobs.size() << " file(s) using " << m_numThreads << " thread(s) and a memory budget of " << static_cast<double>(m_memoryBudget) * glm::pow(2, -30) << "[GiB]." << std::endl;
+            scheduler.run(std::move(jobs));
+            scheduler.printTimings(tag);
         }
-        static void insertVoxel(std::map<uint32_t, std::vector<glm::ivec4>> &voxels, uint32_t typeId, const glm::ivec3 offset, const int32_t vx, const int32_t vy, const int32_t vz, const uint32_t id) {
-            if (voxels.contains(typeId)) {
-                voxels[typeId].emplace_back(offset.x + vx, offset.y + vy, offset.z + vz, id);
+
+        /**
+         * Estimated peak memory of voxelTypeToAABBsAndOctree: raw file + voxel vectors + voxels copied into the octree build infos.
+         * Of VoxelBricks only the voxels of one chunk are expanded at once, the octrees of all chunks are kept for the SVDAG (at most one node per voxel).
+         */
+        [[nodiscard]] uint64_t voxelFootprint(const VoxelSource &source, const bool buildSVDAG) const {
+            uint64_t bytesVoxels;
+            uint64_t numVoxels;
+            if (source.isBricks()) {
+                const VoxelBricks::Info info = source.extents.empty() ? VoxelBricks::info(source.entry.path().string()) : VoxelBricks::info(source.extents);
+                bytesVoxels = info.numBricks * sizeof(VoxelBricks::Brick) + std::min(info.numVoxels, m_chunkVoxels) * sizeof(glm::ivec3);
+                numVoxels = info.numVoxels;
             } else {
-                voxels.insert({typeId, {{offset.x + vx, offset.y + vy, offset.z + vz, id}}});
+                bytesVoxels = source.entry.file_size();
+                numVoxels = bytesVoxels / sizeof(glm::ivec3);
             }
+            return 3 * bytesVoxels + (buildSVDAG ? octreeFootprint(0, numVoxels * sizeof(Octree::OctreeNode)) : 0);
         }
 
-        void writeVoxels(std::map<uint32_t, std::vector<glm::ivec3>> &voxels) const {
-            for (auto &type: voxels) {
-                std::ofstream(m_data + "/" + m_scene + "/" + m_stringVoxels + "/" + m_prefix + std::to_string(type.first) + ".bin", std::ios::binary | std::ios::app)
-                        .write(reinterpret_cast<char *>(type.second.data()), static_cast<std::streamsize>(type.second.size() * sizeof(glm::ivec3)));
+        // bricks [begin, end) of a label, firstInstance is the instance of the id of the first brick
+        struct BrickChunk {
+            uint64_t begin;
+            uint64_t end;
+            size_t firstInstance;
+        };
 
-                std::cout << m_prefix << type.first << " has " << type.second.size() << " voxels." << std::endl;
+        /**
+         * Splits the bricks of a label, sorted by (id, z, y, x), into runs of whole bricks with at most maxVoxels voxels (at least one brick per chunk),
+         * i.e. a chunk is a range of rows of the 16^3 lattice of one or more ids and the chunks of an id are disjoint.
+         */
+        static std::vector<BrickChunk> brickChunks(const std::vector<VoxelBricks::Brick> &bricks, const uint64_t maxVoxels) {
+            std::vector<BrickChunk> chunks;
+            size_t instance = 0;
+            uint64_t numVoxels = 0;
+            for (uint64_t i = 0; i < bricks.size(); i++) {
+                if (i > 0 && bricks[i].id != bricks[i - 1].id) {
+                    instance++;
+                }
+                const uint64_t brickVoxels = VoxelBricks::countVoxels(bricks[i].mask);
+                if (chunks.empty() || numVoxels + brickVoxels > maxVoxels) {
+                    chunks.push_back({.begin = i, .end = i, .firstInstance = instance});
+                    numVoxels = 0;
+                }
+                chunks.back().end = i + 1;
+                numVoxels += brickVoxels;
             }
+            return chunks;
         }
 
-        void writeVoxels(std::map<uint32_t, std::vector<glm::ivec4>> &voxels) const {
-            for (auto &type: voxels) {
-                std::ofstream(m_data + "/" + m_scene + "/" + m_stringVoxels + "/" + m_prefix + std::to_string(type.first) + ".bin", std::ios::binary | std::ios::app)
-                        .write(reinterpret_cast<char *>(type.second.data()), static_cast<std::streamsize>(type.second.size() * sizeof(glm::ivec4)));
+        /**
+         * Writes the SVO of the label if writeSVO, builds and writes its SVDAG from the in-memory octrees if arena != nullptr.
+         * The bricks of a label are processed in chunks of at most m_chunkVoxels voxels (see brickChunks), every chunk is expanded, subdivided and turned into octrees on its own
+         * and its AABBs and octrees are appended to the ones of the previous chunks. Labels of up to m_chunkVoxels voxels are a single chunk.
+         */
+        void voxelTypeToAABBsAndOctree(const VoxelSource &source, const std::string &filename, const uint32_t typeId, const bool writeSVO, DAGBuildArena *arena, LabelScheduler &scheduler) const {
+            scheduler.log("[" + filename + "]");
+
+            std::vector<VoxelAABB> aabbs;
+            Octree octreeBuilder(m_octreeBuilder); // every chunk appends its octrees to m_octrees
+            double cpuTime = 0.0;
+            if (!source.isBricks()) {
+                uint64_t numVoxels;
+                std::map<uint32_t, std::pair<iAABB, std::vector<glm::ivec3>>> voxels;
+                loadVoxels(source.entry, numVoxels, voxels);
+                // bricks cannot contain a voxel twice, the voxels of legacy files can
+                uint64_t numDuplicates = 0;
+                for (auto &[id, voxel]: voxels) {
+                    numDuplicates += removeDuplicateVoxels(voxel.second, voxel.first);
+                }
+                if (numDuplicates > 0) {
+                    scheduler.log("[" + filename + "] Removed " + std::to_string(numDuplicates) + " duplicate voxel(s) of " + std::to_string(numVoxels) + ".");
+                }
+                cpuTime += chunkToAABBsAndOctrees(filename, typeId, 0, voxels, {}, octreeBuilder, aabbs, scheduler);
+            } else {
+                std::vector<VoxelBricks::Brick> bricks;
+                readVoxelBricks(source, bricks);
+                const std::vector<BrickChunk> chunks = brickChunks(bricks, m_chunkVoxels);
+                if (chunks.size() > 1) {
+                    scheduler.log("[" + filename + "] Processing " + std::to_string(bricks.size()) + " brick(s) in " + std::to_string(chunks.size()) + " chunks.");
+                }
+                for (const auto &chunk: chunks) {
+                    const std::span<const VoxelBricks::Brick> chunkBricks(bricks.data() + chunk.begin, chunk.end - chunk.begin);
+                    // the grid-aligned subdivision builds the octrees from the bricks without expanding them into voxels
+                    std::map<uint32_t, std::pair<iAABB, std::vector<glm::ivec3>>> voxels;
+                    if (m_subdivision != SUBDIVISION_GRID_ALIGNED) {
+                        uint64_t numVoxels;
+                        expandVoxelBricks(chunkBricks, numVoxels, voxels);
+                    }
+                    cpuTime += chunkToAABBsAndOctrees(filename, typeId, chunk.firstInstance, voxels, m_subdivision == SUBDIVISION_GRID_ALIGNED ? chunkBricks : std::span<const VoxelBricks::Brick>(), octreeBuilder, aabbs, scheduler);
+                }
+            }
+            scheduler.recordTiming(filename, cpuTime);
+            scheduler.log("[" + filename + "] [SVO] " + std::to_string(cpuTime) + "[ms]");
+
+            // write
+            if (writeSVO) {
+                std::ofstream(m_data + "/" + m_scene + "/" + m_stringSVO + "/aabb/" + m_prefix + std::to_string(typeId) + ".bin", std::ios::binary)
+                        .write(reinterpret_cast<char *>(aabbs.data()), static_cast<std::streamsize>(aabbs.size() * sizeof(VoxelAABB)));
+                std::ofstream(m_data + "/" + m_scene + "/" + m_stringSVO + "/lod/" + m_prefix + std::to_string(typeId) + ".bin", std::ios::binary)
+                        .write(reinterpret_cast<char *>(octreeBuilder.m_octrees.data()), static_cast<std::streamsize>(octreeBuilder.m_octrees.size() * sizeof(Octree::OctreeNode)));
+            }
 
-                std::cout << m_prefix << type.first << " has " << type.second.size() << " voxels." << std::endl;
+            if (arena != nullptr) {
+                if (aabbs.size() > UINT32_MAX) {
+                    throw std::runtime_error("Number of AABBs exceeds 32 bits.");
+                }
+                arena->clear();
+                octreesToDAG(filename, typeId, aabbs.data(), static_cast<uint32_t>(aabbs.size()), octreeBuilder.m_octrees.data(), *arena, scheduler);
+            }
+        }
+
+        /**
+         * Subdivides the voxels of the ids of a chunk (or its bricks, see subdivideBricks), the ids are the instances firstInstance, firstInstance + 1, ... of the label.
+         * The octrees are appended to octreeBuilder.m_octrees and their AABBs to outAABBs, returns the time in ms.
+         */
+        double chunkToAABBsAndOctrees(const std::string &filename, const uint32_t typeId, const size_t firstInstance, std::map<uint32_t, std::pair<iAABB, std::vector<glm::ivec3>>> &voxels, const std::span<const VoxelBricks::Brick> bricks, Octree &octreeBuilder, std::vector<VoxelAABB> &outAABBs, LabelScheduler &scheduler) const {
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+            // subdivide
+            std::vector<Octree::OctreeBuildInfo> octreeBuildInfos;
+            scheduler.log("[" + filename + "] Subdividing " + (bricks.empty() ? std::to_string(voxels.size()) + " id(s)." : std::to_string(bricks.size()) + " brick(s)."));
+            subdivideBricks(bricks, typeId, firstInstance, octreeBuildInfos);
+            size_t instance = firstInstance;
+            for (auto &[id, voxel]: voxels) {
+                if (m_subdivision == SUBDIVISION_MORTON_BUCKETS || m_subdivision == SUBDIVISION_GRID_ALIGNED) {
+                    subdivideMorton(voxel.second, voxel.first, toLabelId(typeId, instance), m_subdivision == SUBDIVISION_GRID_ALIGNED, octreeBuildInfos);
+                } else {
+                    subdivide(voxel.second, 0, voxel.second.size(), voxel.first, toLabelId(typeId, instance), octreeBuildInfos);
+                }
+                instance++;
+            }
+            scheduler.log("[" + filename + "] Subdivided.");
+
+            // build octrees
+            octreeBuilder.buildOctrees(octreeBuildInfos);
+            scheduler.log("[" + filename + "] SVOs built.");
+
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+            for (uint64_t j = 0; j < octreeBuildInfos.size(); j++) {
+                const auto &octreeBuildInfo = octreeBuildInfos[j];
+                outAABBs.push_back(VoxelAABB{octreeBuildInfo.aabb.m_min.x, octreeBuildInfo.aabb.m_min.y, octreeBuildInfo.aabb.m_min.z,
+                                             octreeBuildInfo.aabb.m_max.x, octreeBuildInfo.aabb.m_max.y, octreeBuildInfo.aabb.m_max.z,
+                                             octreeBuildInfo.labelId, octreeBuilder.m_octreeIndices[j]});
             }
+            return static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) * std::pow(10, -3);
         }
 
-        virtual void loadVoxels(const std::filesystem::directory_entry &type, uint32_t &numVoxels, std::map<uint32_t, std::pair<iAABB, std::vector<glm::ivec3>>> &voxels) const {
+        // legacy voxel files (one glm::ivec3 per voxel), VoxelBricks are read with readVoxelBricks
+        virtual void loadVoxels(const std::filesystem::directory_entry &type, uint64_t &numVoxels, std::map<uint32_t, std::pair<iAABB, std::vector<glm::ivec3>>> &voxels) const {
             std::vector<char> voxelsRaw;
 
             const uint64_t bytesVoxels = std::filesystem::file_size(type.path());
-            if (bytesVoxels / sizeof(glm::ivec3) > UINT32_MAX) {
-                throw std::runtime_error("numVoxels > UINT32_MAX");
-            }
             numVoxels = bytesVoxels / sizeof(glm::ivec3);
             voxelsRaw.resize(bytesVoxels);
             std::ifstream(type.path(), std::ios::binary).read(voxelsRaw.data(), static_cast<std::streamsize>(bytesVoxels));
 
             auto *voxelsVec = reinterpret_cast<glm::ivec3 *>(voxelsRaw.data());
 
-            // std::map<int32_t, std::map<int32_t, std::map<int32_t, bool>>> voxelsMap3D;
-            // uint64_t duplicateVoxels = 0;
-
-            for (uint32_t i = 0; i < numVoxels; i++) {
+            for (uint64_t i = 0; i < numVoxels; i++) {
                 auto voxel = voxelsVec[i];
                 voxels[0].second.push_back(voxel);
                 voxels[0].first.expand(voxel);
                 voxels[0].first.expand(voxel + glm::ivec3(1, 1, 1));
+            }
+        }
+
+        static void readVoxelBricks(const VoxelSource &source, std::vector<VoxelBricks::Brick> &outBricks) {
+            if (source.extents.empty()) {
+                VoxelBricks::read(source.entry.path().string(), outBricks);
+            } else {
+                VoxelBricks::read(source.entry.path().string(), source.extents, outBricks);
+            }
+        }
 
-                // if (voxelsMap3D.contains(voxel.x)) {
-                //     if (voxelsMap3D[voxel.x].contains(voxel.y)) {
-                //         if (voxelsMap3D[voxel.x][voxel.y].contains(voxel.z)) {
-                //             // std::cout << "duplicate voxel: " << voxel.x << "," << voxel.y << "," << voxel.z << std::endl;
-                //             duplicateVoxels++;
-                //         } else {
-                //             voxelsMap3D[voxel.x][voxel.y][voxel.z] = true;
-                //         }
-                //     } else {
-                //         voxelsMap3D[voxel.x][voxel.y][voxel.z] = true;
-                //     }
-                // } else {
-                //     voxelsMap3D[voxel.x][voxel.y][voxel.z] = true;
-                // }
+        // expands the bricks of every id into its voxels
+        static void expandVoxelBricks(const std::span<const VoxelBricks::Brick> bricks, uint64_t &numVoxels, std::map<uint32_t, std::pair<iAABB, std::vector<glm::ivec3>>> &voxels) {
+            numVoxels = 0;
+            for (const auto &brick: bricks) {
+                auto &[aabb, idVoxels] = voxels[brick.id];
+                VoxelBricks::expand(brick, idVoxels);
+                const iAABB brickAABB = VoxelBricks::bounds(brick);
+                aabb.expand(brickAABB.m_min);
+                aabb.expand(brickAABB.m_max);
+                numVoxels += VoxelBricks::countVoxels(brick.mask);
             }
-            // std::cout << "duplicate voxels: " << duplicateVoxels << " total voxels: " << numVoxels << std::endl;
         }
 
         [[nodiscard]] virtual uint32_t toLabelId(const uint32_t typeId, const size_t instance) const {
             return typeId;
         }
 
-        static void subdivide(std::vector<glm::ivec3> &voxels, uint32_t voxelIdx, uint32_t numVoxels, iAABB aabb, uint32_t labelId, std::vector<Octree::OctreeBuildInfo> &outOctreeBuildInfos) {
+        static void subdivide(std::vector<glm::ivec3> &voxels, uint64_t voxelIdx, uint64_t numVoxels, iAABB aabb, uint32_t labelId, std::vector<Octree::OctreeBuildInfo> &outOctreeBuildInfos) {
             if (uint32_t maxExtent = aabb.maxExtent(); maxExtent <= 16) {
-                Octree::OctreeBuildInfo octreeBuildInfo{.labelId = labelId, .aabb = aabb};
                 if (numVoxels > 16 * 16 * 16) {
                     throw std::runtime_error("numVoxels > 16 * 16 * 16");
                 }
-                octreeBuildInfo.voxels.insert(octreeBuildInfo.voxels.begin(), voxels.begin() + voxelIdx, voxels.begin() + voxelIdx + numVoxels);
-                outOctreeBuildInfos.push_back(octreeBuildInfo);
+                outOctreeBuildInfos.push_back({.labelId = labelId, .aabb = aabb, .anchor = aabb.m_min, .voxels = std::span(voxels).subspan(voxelIdx, numVoxels)});
                 return;
             }
 
             int axis = aabb.maxExtentAxis(); // axis with the longest extent
-            uint32_t numVoxelsHalf = numVoxels / 2;
+            uint64_t numVoxelsHalf = numVoxels / 2;
 
-            std::nth_element(voxels.begin() + voxelIdx, voxels.begin() + voxelIdx + numVoxelsHalf, voxels.begin() + voxelIdx + numVoxels,
+            std::nth_element(voxels.begin() + static_cast<int64_t>(voxelIdx), voxels.begin() + static_cast<int64_t>(voxelIdx + numVoxelsHalf), voxels.begin() + static_cast<int64_t>(voxelIdx + numVoxels),
                              [&axis](const glm::ivec3 &a, const glm::ivec3 &b) -> bool { return a[axis] < b[axis]; });
 
             iAABB firstAABB{};
-            for (uint32_t i = voxelIdx; i < voxelIdx + numVoxelsHalf; i++) {
+            for (uint64_t i = voxelIdx; i < voxelIdx + numVoxelsHalf; i++) {
                 firstAABB.expand(voxels[i]);
                 firstAABB.expand(voxels[i] + glm::ivec3(1, 1, 1));
             }
             iAABB secondAABB{};
-            for (uint32_t i = voxelIdx + numVoxelsHalf; i < voxelIdx + numVoxels; i++) {
+            for (uint64_t i = voxelIdx + numVoxelsHalf; i < voxelIdx + numVoxels; i++) {
                 secondAABB.expand(voxels[i]);
                 secondAABB.expand(voxels[i] + glm::ivec3(1, 1, 1));
             }
@@ -808,6 +1840,157 @@ namespace raven {
             subdivide(voxels, voxelIdx + numVoxelsHalf, numVoxels - numVoxelsHalf, secondAABB, labelId, outOctreeBuildInfos);
         }
 
+        /**
+         * Removes the repeated occurrences of voxels in linear time, returns the number of removed voxels.
+         * The Morton keys of the voxels relative to the AABB are radix sorted, duplicates are adjacent then. Only if there are duplicates,
+         * the voxels are compacted in a second pass that keeps the first occurrence of every voxel and the order of the voxels.
+         */
+        static uint64_t removeDuplicateVoxels(std::vector<glm::ivec3> &voxels, const iAABB aabb) {
+            if (voxels.size() < 2) {
+                return 0;
+            }
+            const glm::uvec3 maxVoxel = glm::uvec3(aabb.m_max - 1 - aabb.m_min);
+            if (glm::max(maxVoxel.x, glm::max(maxVoxel.y, maxVoxel.z)) >> Morton::BITS_PER_AXIS != 0) {
+                throw std::runtime_error("removeDuplicateVoxels: Label AABB exceeds the Morton key range.");
+            }
+            const auto voxelKey = [&aabb](const glm::ivec3 &voxel) -> uint64_t {
+                const glm::uvec3 v = glm::uvec3(voxel - aabb.m_min);
+                return Morton::encode(v.x, v.y, v.z);
+            };
+
+            std::vector<uint64_t> keys(voxels.size());
+            for (uint64_t i = 0; i < voxels.size(); i++) {
+                keys[i] = voxelKey(voxels[i]);
+            }
+            {
+                std::vector<uint64_t> scratch;
+                RadixSort::sort(keys, scratch, [](const uint64_t key) { return key; }, Morton::keyBits(glm::max(maxVoxel.x, glm::max(maxVoxel.y, maxVoxel.z))));
+            }
+            std::unordered_set<uint64_t> duplicateKeys;
+            for (uint64_t i = 1; i < keys.size(); i++) {
+                if (keys[i] == keys[i - 1]) {
+                    duplicateKeys.insert(keys[i]);
+                }
+            }
+            keys.clear();
+            keys.shrink_to_fit();
+            if (duplicateKeys.empty()) {
+                return 0;
+            }
+
+            std::unordered_set<uint64_t> seenKeys; // duplicate keys that occurred before
+            uint64_t numUnique = 0;
+            for (uint64_t i = 0; i < voxels.size(); i++) {
+                const uint64_t key = voxelKey(voxels[i]);
+                if (duplicateKeys.contains(key) && !seenKeys.insert(key).second) {
+                    continue;
+                }
+                voxels[numUnique++] = voxels[i];
+            }
+            const uint64_t numDuplicates = voxels.size() - numUnique;
+            voxels.resize(numUnique);
+            return numDuplicates;
+        }
+
+        /**
+         * Alternative to subdivide in O(n): every voxel is assigned to the 16^3 cell of the label AABB it lies in, the voxels are sorted by the Morton key of their cell
+         * with the parallel radix sort and every run of equal keys becomes one octree with its tight AABB.
+         * If gridAligned, the cells are the cells of the global 16^3 lattice and the octrees are anchored at their cell instead of the minimum of their AABB,
+         * i.e. at the minimum of the tight AABB & ~15 (see ObjectDescriptor::lodAnchorMask).
+         * Subtrees of different labels then share the same alignment, which increases the number of identical SVDAG nodes at the cost of more AABBs.
+         * The octree build infos reference the sorted voxel buffer and are emitted in Morton order.
+         */
+        static void subdivideMorton(std::vector<glm::ivec3> &voxels, const iAABB aabb, const uint32_t labelId, const bool gridAligned, std::vector<Octree::OctreeBuildInfo> &outOctreeBuildInfos) {
+            if (voxels.empty()) {
+                return;
+            }
+            const glm::ivec3 origin = gridAligned ? (aabb.m_min >> 4) * 16 : aabb.m_min; // arithmetic shift, rounds towards -inf
+            const auto cell = [origin](const glm::ivec3 &voxel) -> glm::uvec3 { return glm::uvec3(voxel - origin) >> 4u; };
+            const auto cellKey = [&cell](const glm::ivec3 &voxel) -> uint64_t {
+                const glm::uvec3 c = cell(voxel);
+                return Morton::encode(c.x, c.y, c.z);
+            };
+            const glm::uvec3 maxCell = cell(aabb.m_max - 1);
+            if (glm::max(maxCell.x, glm::max(maxCell.y, maxCell.z)) >> Morton::BITS_PER_AXIS != 0) {
+                throw std::runtime_error("subdivideMorton: Label AABB exceeds the Morton key range.");
+            }
+
+            {
+                std::vector<glm::ivec3> scratch;
+                RadixSort::sort(voxels, scratch, cellKey, Morton::keyBits(glm::max(maxCell.x, glm::max(maxCell.y, maxCell.z))));
+            }
+
+            // buckets
+            std::vector<uint64_t> bucketBegin;
+            uint64_t previousKey = cellKey(voxels[0]);
+            bucketBegin.push_back(0);
+            for (uint64_t i = 1; i < voxels.size(); i++) {
+                const uint64_t key = cellKey(voxels[i]);
+                if (key != previousKey) {
+                    bucketBegin.push_back(i);
+                    previousKey = key;
+                }
+            }
+            bucketBegin.push_back(voxels.size());
+
+            // tight AABBs
+            const uint64_t firstBuildInfo = outOctreeBuildInfos.size();
+            const auto numBuckets = static_cast<int64_t>(bucketBegin.size() - 1);
+            outOctreeBuildInfos.resize(firstBuildInfo + numBuckets);
+#pragma omp parallel for schedule(dynamic, 256)
+            for (int64_t b = 0; b < numBuckets; b++) {
+                const auto bucket = std::span(voxels).subspan(bucketBegin[b], bucketBegin[b + 1] - bucketBegin[b]);
+                iAABB bucketAABB{};
+                for (const auto &voxel: bucket) {
+                    bucketAABB.expand(voxel);
+                    bucketAABB.expand(voxel + glm::ivec3(1, 1, 1));
+                }
+                const glm::ivec3 anchor = gridAligned ? origin + glm::ivec3(cell(bucket[0]) * 16u) : bucketAABB.m_min;
+                outOctreeBuildInfos[firstBuildInfo + b] = {.labelId = labelId, .aabb = bucketAABB, .anchor = anchor, .voxels = bucket};
+            }
+        }
+
+        /**
+         * Grid-aligned subdivision of bricks read from a VoxelBricks file: every brick is one octree that is built from its mask.
+         * The bricks of every id are emitted in the Morton order of their cell relative to the minimum brick, i.e. the octrees equal subdivideMorton with gridAligned of the expanded voxels.
+         * The octree build infos reference the masks of the bricks.
+         */
+        void subdivideBricks(const std::span<const VoxelBricks::Brick> bricks, const uint32_t typeId, const size_t firstInstance, std::vector<Octree::OctreeBuildInfo> &outOctreeBuildInfos) const {
+            size_t instance = firstInstance;
+            std::vector<std::pair<uint64_t, uint64_t>> keys; // (Morton key, brick)
+            for (uint64_t first = 0; first < bricks.size(); instance++) {
+                glm::ivec3 minCoordinate(INT32_MAX);
+                glm::ivec3 maxCoordinate(INT32_MIN);
+                uint64_t end = first;
+                for (; end < bricks.size() && bricks[end].id == bricks[first].id; end++) {
+                    minCoordinate = glm::min(minCoordinate, bricks[end].coordinate);
+                    maxCoordinate = glm::max(maxCoordinate, bricks[end].coordinate);
+                }
+                const glm::uvec3 maxCell(maxCoordinate - minCoordinate);
+                if (glm::max(maxCell.x, glm::max(maxCell.y, maxCell.z)) >> Morton::BITS_PER_AXIS != 0) {
+                    throw std::runtime_error("subdivideBricks: Label AABB exceeds the Morton key range.");
+                }
+
+                keys.clear();
+                for (uint64_t i = first; i < end; i++) {
+                    const glm::uvec3 cell(bricks[i].coordinate - minCoordinate);
+                    keys.emplace_back(Morton::encode(cell.x, cell.y, cell.z), i);
+                }
+                std::sort(keys.begin(), keys.end());
+
+                const uint32_t labelId = toLabelId(typeId, instance);
+                const uint64_t firstBuildInfo = outOctreeBuildInfos.size();
+                const auto numBricks = static_cast<int64_t>(keys.size());
+                outOctreeBuildInfos.resize(firstBuildInfo + numBricks);
+#pragma omp parallel for schedule(dynamic, 256)
+                for (int64_t b = 0; b < numBricks; b++) {
+                    const auto &brick = bricks[keys[b].second];
+                    outOctreeBuildInfos[firstBuildInfo + b] = {.labelId = labelId, .aabb = VoxelBricks::bounds(brick), .anchor = brick.coordinate * 16, .voxels = {}, .mask = &brick.mask};
+                }
+                first = end;
+            }
+        }
+
         //  === FROM OCTREE ===
         typedef struct __attribute__((packed)) {
             uint8_t level;  // = 0xFF;// DAG::invalidPointer();
@@ -825,8 +2008,248 @@ namespace raven {
             OctreeLevelIndex child7{};
         };
 
-        static void svdagOccupancyField_fromOctree(const VoxelAABB *cells, Octree::OctreeNode *octrees, DAG::DAGRoot *dagRoot, const uint32_t dagRootCount, std::vector<DAG::DAGNode> &dag, std::vector<DAG::DAGLevel> &dagLevels) {
+        /**
+         * Per worker buffers of AABBsAndOctreesToAABBsAndDAGs. The vectors are cleared but keep their capacity between labels.
+         */
+        struct DAGBuildArena {
+            std::vector<char> aabbRaw;
+            std::vector<char> lodRaw;
+            std::vector<DAG::DAGRoot> dagRoot;
+            std::vector<DAG::DAGNode> dag;
+            std::vector<DAG::DAGLevel> dagLevels;
+            std::vector<DAG::DAGLevel> outDAGLevels;
             std::vector<std::vector<OctreeLI>> dagHierarchy;
+
+            void clear() {
+                aabbRaw.clear();
+                lodRaw.clear();
+                dagRoot.clear();
+                dag.clear();
+                dagLevels.clear();
+                outDAGLevels.clear();
+                for (auto &level: dagHierarchy) {
+                    level.clear();
+                }
+            }
+        };
+
+        struct DAGNodeHash {
+            size_t operator()(const DAG::DAGNode &node) const { return node.hash(); }
+        };
+
+        struct DAGNodeEqual {
+            bool operator()(const DAG::DAGNode &a, const DAG::DAGNode &b) const { return a.equals(b); }
+        };
+
+        /**
+         * Reads the nodes of one level of a sorted input SVDAG in chunks and remaps their child pointers to the merged SVDAG, see mergeSortedDAGs.
+         */
+        struct SortedDAGStream {
+            static constexpr uint32_t BUFFER_SIZE = 4096;
+
+            std::ifstream lod;
+            std::vector<DAG::DAGLevel> levels;
+            std::vector<uint32_t> remap; // input node index -> merged node index
+
+            DAG::DAGNode current{};
+            uint32_t currentIndex = 0;
+
+            std::vector<DAG::DAGNode> buffer;
+            uint32_t bufferIndex = 0; // input node index of buffer[0]
+            uint32_t levelEnd = 0;
+            bool firstInLevel = true;
+
+            bool beginLevel(const uint32_t level) {
+                if (level >= levels.size() || levels[level].count == 0) {
+                    return false;
+                }
+                currentIndex = levels[level].index - 1;
+                levelEnd = levels[level].index + levels[level].count;
+                buffer.clear();
+                bufferIndex = levels[level].index;
+                lod.seekg(static_cast<std::streamoff>(bufferIndex) * static_cast<std::streamoff>(sizeof(DAG::DAGNode)));
+                firstInLevel = true;
+                return next();
+            }
+
+            bool next() {
+                currentIndex++;
+                if (currentIndex >= levelEnd) {
+                    return false;
+                }
+                if (currentIndex >= bufferIndex + buffer.size()) {
+                    bufferIndex = currentIndex;
+                    buffer.resize(std::min(BUFFER_SIZE, levelEnd - currentIndex));
+                    lod.read(reinterpret_cast<char *>(buffer.data()), static_cast<std::streamsize>(buffer.size() * sizeof(DAG::DAGNode)));
+                    if (!lod) {
+                        throw std::runtime_error("Failed to read SVDAG nodes.");
+                    }
+                }
+                const DAG::DAGNode previous = current;
+                current = buffer[currentIndex - bufferIndex];
+                if (!current.isLeaf()) {
+                    current.child0 = remap[current.child0];
+                    current.child1 = remap[current.child1];
+                    current.child2 = remap[current.child2];
+                    current.child3 = remap[current.child3];
+                    current.child4 = remap[current.child4];
+                    current.child5 = remap[current.child5];
+                    current.child6 = remap[current.child6];
+                    current.child7 = remap[current.child7];
+                }
+                if (!firstInLevel && !previous.lexicographicCompare(current)) {
+                    throw std::runtime_error("SVDAG level is not strictly increasing in lexicographic order.");
+                }
+                firstInLevel = false;
+                return true;
+            }
+        };
+
+        // estimated peak memory of AABBsAndOctreeToAABBsAndDAG: raw files + at most one DAG node, one hierarchy node and two reduction indices per octree node
+        [[nodiscard]] static uint64_t octreeFootprint(const uint64_t bytesAABB, const uint64_t bytesLOD) {
+            return bytesAABB + bytesLOD + bytesLOD / sizeof(Octree::OctreeNode) * (sizeof(DAG::DAGNode) + 8 * (sizeof(uint8_t) + sizeof(uint32_t)) + 2 * sizeof(uint32_t));
+        }
+
+        void AABBsAndOctreeToAABBsAndDAG(const std::filesystem::directory_entry &type, const std::string &filename, const uint32_t typeId, DAGBuildArena &arena, LabelScheduler &scheduler) const {
+            scheduler.log("[" + filename + "]");
+
+            arena.clear();
+            auto &aabbRaw = arena.aabbRaw;
+            auto &lodRaw = arena.lodRaw;
+
+            uint32_t numAABB;
+            {
+                uint64_t bytesAABB = std::filesystem::file_size(type.path());
+                uint64_t bytesPerAABB = sizeof(VoxelAABB);
+                if (bytesAABB / bytesPerAABB > UINT32_MAX) {
+                    throw std::runtime_error("Number of AABBs exceeds 32 bits.");
+                }
+                numAABB = static_cast<uint32_t>(bytesAABB / bytesPerAABB);
+                aabbRaw.resize(bytesAABB);
+                std::ifstream(type.path(), std::ios::binary).read(aabbRaw.data(), static_cast<std::streamsize>(bytesAABB));
+
+                uint64_t bytesLOD = std::filesystem::file_size(m_data + "/" + m_scene + "/" + m_stringSVO + "/lod/" + filename);
+                lodRaw.resize(bytesLOD);
+                std::ifstream(m_data + "/" + m_scene + "/" + m_stringSVO + "/lod/" + filename, std::ios::binary).read(lodRaw.data(), static_cast<std::streamsize>(bytesLOD));
+            }
+
+            octreesToDAG(filename, typeId, reinterpret_cast<VoxelAABB *>(aabbRaw.data()), numAABB, reinterpret_cast<Octree::OctreeNode *>(lodRaw.data()), arena, scheduler);
+        }
+
+        // builds the SVDAG of the octrees of a label and writes it, the lod pointers of the AABBs are replaced with the SVDAG roots
+        void octreesToDAG(const std::string &filename, const uint32_t typeId, VoxelAABB *aabbs, const uint32_t numAABB, Octree::OctreeNode *octrees, DAGBuildArena &arena, LabelScheduler &scheduler) const {
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+            // dag
+            auto &dagRoot = arena.dagRoot;
+            dagRoot.resize(numAABB);
+            uint32_t dagRootCount = numAABB;
+            auto &dag = arena.dag;
+            auto &dagLevels = arena.dagLevels;
+
+            uint32_t outDAGCount;
+            auto &outDAGLevels = arena.outDAGLevels;
+            if (m_dagBuilder == DAG_BUILDER_HASH_CONSING) {
+                // initialize and construct
+                hashConsing_fromOctree(m_svdagOccupancyField, aabbs, octrees, dagRoot.data(), dagRootCount, dag, dagLevels);
+                outDAGCount = dagLevels[dagLevels.size() - 1].index + dagLevels[dagLevels.size() - 1].count;
+                outDAGLevels = dagLevels;
+            } else {
+                // initialize
+                if (m_svdagOccupancyField) {
+                    svdagOccupancyField_fromOctree(aabbs, octrees, dagRoot.data(), dagRootCount, arena.dagHierarchy, dag, dagLevels);
+                } else {
+                    svdag_fromOctree(aabbs, octrees, dagRoot.data(), dagRootCount, arena.dagHierarchy, dag, dagLevels);
+                }
+                uint32_t dagCount = dagLevels[dagLevels.size() - 1].index + dagLevels[dagLevels.size() - 1].count;
+
+                // construct
+                DAG dagConstruct(dagRoot.data(), dagRootCount, dag.data(), dagCount, dagLevels);
+                // dagConstruct.verify();
+                scheduler.log("[" + filename + "] Start reduce.");
+                outDAGLevels.resize(dagLevels.size());
+                dagConstruct.reduce(&outDAGCount, outDAGLevels, m_reduceMode);
+                scheduler.log("[" + filename + "] End reduce.");
+            }
+            // DAG dagVerify(dagRoot.data(), dagRootCount, dag.data(), outDAGCount, outDAGLevels);
+            // dagVerify.verify();
+
+            // update aabb pointers
+            for (uint32_t j = 0; j < numAABB; j++) {
+                auto &aabb = aabbs[j];
+                aabb.lod = dagRoot[j];
+            }
+
+            scheduler.log("[" + filename + "] DAG built.");
+
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+            double cpuTime = (static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) * std::pow(10, -3));
+            scheduler.recordTiming(filename, cpuTime);
+            scheduler.log("[" + filename + "] [SVDAG] " + std::to_string(cpuTime) + "[ms]");
+
+            // write
+            std::ofstream(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/aabb/" + m_prefix + std::to_string(typeId) + ".bin", std::ios::binary)
+                    .write(reinterpret_cast<char *>(aabbs), static_cast<std::streamsize>(numAABB * sizeof(VoxelAABB)));
+            std::ofstream(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/lod/" + m_prefix + std::to_string(typeId) + ".bin", std::ios::binary)
+                    .write(reinterpret_cast<char *>(dag.data()), static_cast<std::streamsize>(outDAGCount * sizeof(DAG::DAGNode)));
+            writeDAGLevels(m_data + "/" + m_scene + "/" + stringSVDAG(false) + "/lod_data/" + m_prefix + std::to_string(typeId) + ".bin", outDAGLevels,
+                           m_dagBuilder == DAG_BUILDER_REDUCE ? DAG::sortOrder(m_reduceMode) : DAG::SORT_ORDER_NONE);
+        }
+
+        static uint32_t insertNode(std::vector<std::vector<OctreeLI>> &dag, const uint32_t level, const OctreeLI &node) {
+            if (dag.size() < level + 1) {
+                dag.resize(level + 1);
+            }
+            dag[level].push_back(node);
+            return dag[level].size() - 1;
+        }
+
+        static uint32_t insertNode(DAGInterner<OctreeLI> &dag, const uint32_t level, const OctreeLI &node) {
+            return dag.intern(level, node);
+        }
+
+        /**
+         * Builds the reduced SVDAG directly: octrees are traversed in parallel and every node is interned into its level, such that the
+         * undeduplicated hierarchy is never materialized and no DAG::reduce is required. The order of the nodes within a level is not deterministic.
+         */
+        static void hashConsing_fromOctree(const bool svdagOccupancyField, const VoxelAABB *cells, Octree::OctreeNode *octrees, DAG::DAGRoot *dagRoot, const uint32_t dagRootCount, std::vector<DAG::DAGNode> &dag, std::vector<DAG::DAGLevel> &dagLevels) {
+            constexpr uint32_t maxLevels = 5; // root extent 16 down to leaves of extent 1
+            DAGInterner<OctreeLI> dagHierarchy(maxLevels);
+            std::vector<OctreeLevelIndex> rootIndex(dagRootCount);
+
+            tbb::parallel_for(tbb::blocked_range<uint32_t>(0, dagRootCount), [&](const tbb::blocked_range<uint32_t> &range) {
+                for (uint32_t i = range.begin(); i < range.end(); i++) {
+                    const auto &cell = cells[i];
+                    uint32_t level;
+                    uint32_t index;
+                    if (svdagOccupancyField) {
+                        svdagOccupancyField_traverseOctree(16, dagHierarchy, octrees, cell.lod, 0, &level, &index);
+                    } else {
+                        svdag_traverseOctree(16, dagHierarchy, octrees, cell.lod, 0, &level, &index);
+                    }
+                    rootIndex[i] = {static_cast<uint8_t>(level), index};
+                }
+            });
+
+            dagLevels.resize(dagHierarchy.size());
+            uint32_t num = 0;
+            for (uint32_t level = 0; level < dagHierarchy.size(); level++) {
+                num += dagHierarchy[level].size();
+            }
+            dag.resize(num);
+            if (svdagOccupancyField) {
+                svdagOccupancyField_encodeDAG(dagHierarchy, dag.data(), dagLevels);
+            } else {
+                svdag_encodeDAG(dagHierarchy, dag.data(), dagLevels);
+            }
+
+            for (uint32_t i = 0; i < dagRootCount; i++) {
+                const auto &root = rootIndex[i];
+                dagRoot[i] = dagLevels[root.level].index + root.index;
+            }
+        }
+
+        static void svdagOccupancyField_fromOctree(const VoxelAABB *cells, Octree::OctreeNode *octrees, DAG::DAGRoot *dagRoot, const uint32_t dagRootCount, std::vector<std::vector<OctreeLI>> &dagHierarchy, std::vector<DAG::DAGNode> &dag, std::vector<DAG::DAGLevel> &dagLevels) {
             std::vector<OctreeLevelIndex> rootIndex(dagRootCount);
             uint32_t maxLevel = 0;
 
@@ -839,6 +2262,7 @@ namespace raven {
                 maxLevel = glm::max(level, maxLevel);
             }
 
+            dagHierarchy.resize(maxLevel + 1); // drop stale levels of a reused hierarchy
             dagLevels.resize(maxLevel + 1);
             uint32_t num = 0;
             for (const auto &level: dagHierarchy) {
@@ -853,7 +2277,8 @@ namespace raven {
             }
         }
 
-        static void svdagOccupancyField_encodeDAG(const std::vector<std::vector<OctreeLI>> &dagHierarchy, DAG::DAGNode *dag, std::vector<DAG::DAGLevel> &dagLevels) {
+        template<typename Hierarchy>
+        static void svdagOccupancyField_encodeDAG(const Hierarchy &dagHierarchy, DAG::DAGNode *dag, std::vector<DAG::DAGLevel> &dagLevels) {
             uint32_t globalIndex = 0;
             for (int32_t level = 0; level < dagHierarchy.size(); level++) {
                 dagLevels[level].index = globalIndex;
@@ -941,7 +2366,8 @@ namespace raven {
             svdagOccupancyField_encodeBitField(field, nextExtent, anchor + static_cast<int32_t>(nextExtent) * svdagOccupancyField_linearChildToVector(7), octrees, rootIndex, child + 7);
         }
 
-        static void svdagOccupancyField_traverseOctree(uint32_t extent, std::vector<std::vector<OctreeLI>> &dag, Octree::OctreeNode *octrees, uint32_t rootIndex, uint32_t index, uint32_t *childLevel,
+        template<typename Hierarchy>
+        static void svdagOccupancyField_traverseOctree(uint32_t extent, Hierarchy &dag, Octree::OctreeNode *octrees, uint32_t rootIndex, uint32_t index, uint32_t *childLevel,
                                                        uint32_t *childIndex) {
             auto &octree = octrees[rootIndex + index];
 
@@ -962,12 +2388,8 @@ namespace raven {
                               .child5{0xFF, DAG::invalidPointer()},
                               .child6{0xFF, DAG::invalidPointer()},
                               .child7{0xFF, DAG::invalidPointer()}};
-                if (dag.empty()) {
-                    dag.resize(1);
-                }
-                dag[0].push_back(node);
                 *childLevel = 0;
-                *childIndex = dag[0].size() - 1;
+                *childIndex = insertNode(dag, 0, node);
                 return;
             }
             if (extent <= 4) {
@@ -983,12 +2405,8 @@ namespace raven {
                               .child5{0xFF, DAG::invalidPointer()},
                               .child6{0xFF, DAG::invalidPointer()},
                               .child7{0xFF, DAG::invalidPointer()}};
-                if (dag.empty()) {
-                    dag.resize(1);
-                }
-                dag[0].push_back(node);
                 *childLevel = 0;
-                *childIndex = dag[0].size() - 1;
+                *childIndex = insertNode(dag, 0, node);
                 return;
             }
 
@@ -1031,16 +2449,10 @@ namespace raven {
                           .child5 = {static_cast<uint8_t>(child5Level), child5Index},
                           .child6 = {static_cast<uint8_t>(child6Level), child6Index},
                           .child7 = {static_cast<uint8_t>(child7Level), child7Index}};
-            if (dag.size() < maxChildLevel + 2) {
-                dag.resize(maxChildLevel + 2);
-            }
-            dag[*childLevel].push_back(node);
-
-            *childIndex = dag[*childLevel].size() - 1;
+            *childIndex = insertNode(dag, *childLevel, node);
         }
 
-        static void svdag_fromOctree(const VoxelAABB *cells, Octree::OctreeNode *octrees, DAG::DAGRoot *dagRoot, const uint32_t dagRootCount, std::vector<DAG::DAGNode> &dag, std::vector<DAG::DAGLevel> &dagLevels) {
-            std::vector<std::vector<OctreeLI>> dagHierarchy;
+        static void svdag_fromOctree(const VoxelAABB *cells, Octree::OctreeNode *octrees, DAG::DAGRoot *dagRoot, const uint32_t dagRootCount, std::vector<std::vector<OctreeLI>> &dagHierarchy, std::vector<DAG::DAGNode> &dag, std::vector<DAG::DAGLevel> &dagLevels) {
             std::vector<OctreeLevelIndex> rootIndex(dagRootCount);
             uint32_t maxLevel = 0;
 
@@ -1053,6 +2465,7 @@ namespace raven {
                 maxLevel = glm::max(level, maxLevel);
             }
 
+            dagHierarchy.resize(maxLevel + 1); // drop stale levels of a reused hierarchy
             dagLevels.resize(maxLevel + 1);
             uint32_t num = 0;
             for (const auto &level: dagHierarchy) {
@@ -1067,7 +2480,8 @@ namespace raven {
             }
         }
 
-        static void svdag_encodeDAG(const std::vector<std::vector<OctreeLI>> &dagHierarchy, DAG::DAGNode *dag, std::vector<DAG::DAGLevel> &dagLevels) {
+        template<typename Hierarchy>
+        static void svdag_encodeDAG(const Hierarchy &dagHierarchy, DAG::DAGNode *dag, std::vector<DAG::DAGLevel> &dagLevels) {
             uint32_t globalIndex = 0;
             for (int32_t level = 0; level < dagHierarchy.size(); level++) {
                 dagLevels[level].index = globalIndex;
@@ -1091,7 +2505,8 @@ namespace raven {
             }
         }
 
-        static void svdag_traverseOctree(const uint32_t extent, std::vector<std::vector<OctreeLI>> &dag, Octree::OctreeNode *octrees, const uint32_t rootIndex, const uint32_t index, uint32_t *childLevel, uint32_t *childIndex) {
+        template<typename Hierarchy>
+        static void svdag_traverseOctree(const uint32_t extent, Hierarchy &dag, Octree::OctreeNode *octrees, const uint32_t rootIndex, const uint32_t index, uint32_t *childLevel, uint32_t *childIndex) {
             auto &octree = octrees[rootIndex + index];
 
             const uint16_t solid = OCTREE_NODE_SOLID(octree);
@@ -1110,12 +2525,8 @@ namespace raven {
                               .child5{0xFF, DAG::invalidPointer()},
                               .child6{0xFF, DAG::invalidPointer()},
                               .child7{0xFF, DAG::invalidPointer()}};
-                if (dag.empty()) {
-                    dag.resize(1);
-                }
-                dag[0].push_back(node);
                 *childLevel = 0;
-                *childIndex = dag[0].size() - 1;
+                *childIndex = insertNode(dag, 0, node);
                 return;
             }
 
@@ -1158,12 +2569,7 @@ namespace raven {
                           .child5 = {static_cast<uint8_t>(child5Level), child5Index},
                           .child6 = {static_cast<uint8_t>(child6Level), child6Index},
                           .child7 = {static_cast<uint8_t>(child7Level), child7Index}};
-            if (dag.size() < maxChildLevel + 2) {
-                dag.resize(maxChildLevel + 2);
-            }
-            dag[*childLevel].push_back(node);
-
-            *childIndex = dag[*childLevel].size() - 1;
+            *childIndex = insertNode(dag, *childLevel, node);
         }
 
         static uint32_t sectionUpdatePointer(const uint64_t volume, const uint64_t pointer, const std::vector<DAG::DAGLevel> &dagLevels, const std::vector<std::vector<DAG::DAGLevel>> &offsetDAGLevels,
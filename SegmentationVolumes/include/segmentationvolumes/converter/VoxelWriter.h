@@ -0,0 +1,146 @@
+#pragma once
+
+#include "BoundedQueue.h"
+#include "builder/VoxelBricks.h"
+
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace raven {
+    /**
+     * Collects the bricks of the labels from any number of threads and writes them on a background flusher thread.
+     * The bricks are buffered per label, once the buffered bricks exceed the budget all buffers are handed to the flusher as one batch,
+     * i.e. a label is appended to once per batch instead of once per volume chunk. While a batch is written, the next one is queued and a third one is buffered,
+     * a producer that fills the buffer beyond that blocks until the flusher is done, hence at most ~3 * budget bytes of bricks are held.
+     * - LAYOUT_FILE_PER_LABEL: the bricks of a label are appended to <directory>/<prefix><label>.bricks
+     * - LAYOUT_SHARDED: the bricks of all labels of a batch are appended to <directory>/<name>.shards with a single write, see VoxelBricks::appendShards
+     * Errors of the flusher are rethrown by the next write() or by close().
+     */
+    class VoxelWriter {
+    public:
+        enum Layout {
+            LAYOUT_FILE_PER_LABEL,
+            LAYOUT_SHARDED,
+        };
+
+        VoxelWriter(std::string directory, std::string prefix, const std::string &name, const Layout layout, const uint64_t budget)
+            : m_directory(std::move(directory)), m_prefix(std::move(prefix)), m_container(m_directory + "/" + name + VoxelBricks::SHARD_EXTENSION), m_layout(layout), m_budget(budget), m_flusher([this] { flushBatches(); }) {}
+
+        VoxelWriter(const VoxelWriter &) = delete;
+        VoxelWriter &operator=(const VoxelWriter &) = delete;
+
+        // without close(), e.g. while unwinding, the bricks that have not been handed to the flusher yet are discarded
+        ~VoxelWriter() {
+            m_batches.close();
+            if (m_flusher.joinable()) {
+                m_flusher.join();
+            }
+        }
+
+        [[nodiscard]] std::string labelFile(const uint32_t label) const {
+            return m_directory + "/" + m_prefix + std::to_string(label) + VoxelBricks::EXTENSION;
+        }
+
+        void write(const uint32_t label, std::vector<VoxelBricks::Brick> bricks) {
+            std::map<uint32_t, std::vector<VoxelBricks::Brick>> labels;
+            labels.emplace(label, std::move(bricks));
+            write(std::move(labels));
+        }
+
+        // label -> bricks
+        void write(std::map<uint32_t, std::vector<VoxelBricks::Brick>> labels) {
+            Batch batch;
+            {
+                std::lock_guard lock(m_mutex);
+                for (auto &[label, bricks]: labels) {
+                    auto &buffer = m_buffers[label];
+                    m_bufferedBytes += bricks.size() * sizeof(VoxelBricks::Brick);
+                    if (buffer.empty()) {
+                        buffer = std::move(bricks);
+                    } else {
+                        buffer.insert(buffer.end(), bricks.begin(), bricks.end());
+                    }
+                }
+                if (m_bufferedBytes < m_budget) {
+                    return;
+                }
+                batch = std::exchange(m_buffers, {});
+                m_bufferedBytes = 0;
+            }
+            if (!m_batches.push(std::move(batch))) {
+                rethrow();
+                throw std::runtime_error("VoxelWriter: Write after close.");
+            }
+        }
+
+        // writes the buffered bricks and waits for the flusher
+        void close() {
+            Batch batch;
+            {
+                std::lock_guard lock(m_mutex);
+                batch = std::exchange(m_buffers, {});
+                m_bufferedBytes = 0;
+            }
+            if (!batch.empty()) {
+                m_batches.push(std::move(batch));
+            }
+            m_batches.close();
+            if (m_flusher.joinable()) {
+                m_flusher.join();
+            }
+            rethrow();
+        }
+
+    private:
+        typedef std::map<uint32_t, std::vector<VoxelBricks::Brick>> Batch; // label -> bricks
+
+        std::string m_directory;
+        std::string m_prefix;
+        std::string m_container;
+        Layout m_layout;
+        uint64_t m_budget;
+
+        std::mutex m_mutex;
+        Batch m_buffers;
+        uint64_t m_bufferedBytes = 0;
+
+        BoundedQueue<Batch> m_batches{1};
+        std::exception_ptr m_exception;
+        std::mutex m_exceptionMutex;
+        std::thread m_flusher; // last member, started once all other members are initialized
+
+        void flushBatches() {
+            try {
+                while (auto batch = m_batches.pop()) {
+                    if (m_layout == LAYOUT_SHARDED) {
+                        VoxelBricks::appendShards(m_container, *batch);
+                        continue;
+                    }
+                    for (const auto &[label, bricks]: *batch) {
+                        VoxelBricks::append(labelFile(label), bricks);
+                    }
+                }
+            } catch (...) {
+                {
+                    std::lock_guard lock(m_exceptionMutex);
+                    m_exception = std::current_exception();
+                }
+                m_batches.close(); // unblocks and fails the producers
+            }
+        }
+
+        void rethrow() {
+            std::lock_guard lock(m_exceptionMutex);
+            if (m_exception) {
+                std::rethrow_exception(m_exception);
+            }
+        }
+    };
+} // namespace raven
@@ -1,10 +1,16 @@
 #pragma once
 
+#include "RadixSort.h"
+
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <execution>
 #include <iostream>
+#include <numeric>
 #include <stdexcept>
+#include <tuple>
 #include <vector>
 
 #define LOD_HEADER
@@ -51,6 +57,10 @@ namespace raven {
                 return seed < otherSeed;
             }
 
+            [[nodiscard]] bool lexicographicCompare(const DAGNode &other) const {
+                return std::tie(child0, child1, child2, child3, child4, child5, child6, child7) < std::tie(other.child0, other.child1, other.child2, other.child3, other.child4, other.child5, other.child6, other.child7);
+            }
+
             [[nodiscard]] bool equals(const DAGNode &other) const {
                 return child0 == other.child0 && child1 == other.child1 && child2 == other.child2 && child3 == other.child3 && child4 == other.child4 && child5 == other.child5 && child6 == other.child6 && child7 == other.child7;
             }
@@ -77,6 +87,29 @@ namespace raven {
 
         typedef uint32_t DAGRoot;
 
+        enum ReduceMode {
+            REDUCE_MODE_HASH_COMPARATOR, // comparison sort on DAGNode::hash(), duplicates are only detected among neighbours
+            REDUCE_MODE_RADIX_SORT,      // hash computed once per node, radix sort of (hash, index) pairs, equal hash runs resolved with DAGNode::equals()
+            REDUCE_MODE_LEXICOGRAPHIC,   // comparison sort on DAGNode::lexicographicCompare(), the reduced levels are in canonical order (SORT_ORDER_LEXICOGRAPHIC)
+        };
+
+        /**
+         * Order of the nodes within every level of a reduced DAG.
+         * SORT_ORDER_LEXICOGRAPHIC: nodes are strictly increasing w.r.t. DAGNode::lexicographicCompare(). Since pointers into lower levels are remapped monotonically
+         * when such DAGs are merged level by level, the remapped levels stay sorted and can be merged with a k-way merge.
+         * SORT_ORDER_INDEXED: nodes are in no particular order and the levels may contain free slots, the lexicographic order of the used slots is stored
+         * separately (lod_index of a merged SVDAG that labels are appended to, see SegmentationVolumeConverter::appendDAGs).
+         */
+        enum SortOrder : uint32_t {
+            SORT_ORDER_NONE = 0,
+            SORT_ORDER_LEXICOGRAPHIC = 1,
+            SORT_ORDER_INDEXED = 2,
+        };
+
+        static SortOrder sortOrder(const ReduceMode reduceMode) {
+            return reduceMode == REDUCE_MODE_LEXICOGRAPHIC ? SORT_ORDER_LEXICOGRAPHIC : SORT_ORDER_NONE;
+        }
+
         /**
      *
      * @param dagRoot [ root node index | root node index | ... ] - each root node index points to a node in the dag
@@ -106,7 +139,7 @@ namespace raven {
             }
         }
 
-        void reduce(uint32_t *outDAGCount, std::vector<DAGLevel> &outDAGLevels) const {
+        void reduce(uint32_t *outDAGCount, std::vector<DAGLevel> &outDAGLevels, const ReduceMode reduceMode = REDUCE_MODE_HASH_COMPARATOR) const {
             if (outDAGLevels.size() != m_dagLevels.size()) {
                 throw std::runtime_error("DAG level count must match.");
             }
@@ -114,12 +147,29 @@ namespace raven {
             uint32_t globalOffset = 0; // points to the first empty index in the dag array
             std::vector<uint32_t> indirectionList(m_dagCount);
             std::vector<uint32_t> indexList(m_dagCount);
+            std::vector<KeyIndex> keys;
+            std::vector<KeyIndex> keysScratch;
+            std::vector<DAGNode> sortedLevel;  // nodes of the current level in sorted order
+            std::vector<uint32_t> uniqueRank; // number of unique nodes in the sorted level up to and including the node
+
+            double timeSort = 0;
+            double timeGather = 0;
+            double timeCompact = 0;
+            double timePointer = 0;
+            auto lap = [](std::chrono::steady_clock::time_point &t) {
+                const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                const double ms = static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(now - t).count()) * std::pow(10, -3);
+                t = now;
+                return ms;
+            };
 
             const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            std::chrono::steady_clock::time_point phase = begin;
 
             // store index pointer of all nodes in level before sorting
-            for (uint32_t i = 0; i < m_dagCount; i++) {
-                indexList[i] = i;
+#pragma omp parallel for if (m_dagCount >= PARALLEL_MIN_COUNT)
+            for (int64_t i = 0; i < static_cast<int64_t>(m_dagCount); i++) {
+                indexList[i] = static_cast<uint32_t>(i);
             }
 
             // bottom up reduction
@@ -130,37 +180,65 @@ namespace raven {
                 outLevel.count = 0;
 
                 const auto &level = m_dagLevels[l];
+                const auto count = static_cast<int64_t>(level.count);
+                const bool parallel = level.count >= PARALLEL_MIN_COUNT;
+                uint32_t *levelIndexList = indexList.data() + level.index;
 
                 // sort level
-                std::sort(std::execution::par_unseq, indexList.begin() + level.index, indexList.begin() + level.index + level.count, [this](const uint32_t &a, const uint32_t &b) { return m_dag[a].compare(m_dag[b]); });
-                for (uint32_t i = level.index; i < level.index + level.count; i++) {
-                    indirectionList[indexList[i]] = i;
-                }
-                for (uint32_t i = level.index; i < level.index + level.count; i++) {
-                    while (indirectionList[i] != i) {
-                        std::swap(m_dag[i], m_dag[indirectionList[i]]);
-                        std::swap(indirectionList[i], indirectionList[indirectionList[i]]);
-                    }
+                switch (reduceMode) {
+                    case REDUCE_MODE_HASH_COMPARATOR:
+                        std::sort(std::execution::par_unseq, indexList.begin() + level.index, indexList.begin() + level.index + level.count, [this](const uint32_t &a, const uint32_t &b) { return m_dag[a].compare(m_dag[b]); });
+                        break;
+                    case REDUCE_MODE_RADIX_SORT:
+                        radixSortLevel(level, levelIndexList, keys, keysScratch);
+                        break;
+                    case REDUCE_MODE_LEXICOGRAPHIC:
+                        std::sort(std::execution::par_unseq, indexList.begin() + level.index, indexList.begin() + level.index + level.count, [this](const uint32_t &a, const uint32_t &b) { return m_dag[a].lexicographicCompare(m_dag[b]); });
+                        break;
                 }
+                timeSort += lap(phase);
 
-                for (uint32_t i = 0; i < level.count; i++) {
-                    auto node = m_dag[level.index + i];
+                // gather level in sorted order
+                sortedLevel.resize(level.count);
+#pragma omp parallel for if (parallel)
+                for (int64_t i = 0; i < count; i++) {
+                    sortedLevel[i] = m_dag[levelIndexList[i]];
+                }
+                timeGather += lap(phase);
 
-                    // compact level
-                    if (const bool unique = i == 0 || !node.equals(m_dag[level.index + i - 1])) {
-                        m_dag[globalOffset] = node;
-                        globalOffset++;
-                        outLevel.count++;
+                // compact level, the first node of each run of equal nodes is kept
+                uniqueRank.resize(level.count);
+#pragma omp parallel for if (parallel)
+                for (int64_t i = 0; i < count; i++) {
+                    uniqueRank[i] = i == 0 || !sortedLevel[i].equals(sortedLevel[i - 1]) ? 1 : 0;
+                }
+                if (parallel) {
+                    std::inclusive_scan(std::execution::par, uniqueRank.begin(), uniqueRank.end(), uniqueRank.begin());
+                } else {
+                    std::inclusive_scan(uniqueRank.begin(), uniqueRank.end(), uniqueRank.begin());
+                }
+                // the output range [globalOffset, globalOffset + unique count) ends before level.index + level.count, higher levels are not overwritten
+#pragma omp parallel for if (parallel)
+                for (int64_t i = 0; i < count; i++) {
+                    const uint32_t outIndex = globalOffset + uniqueRank[i] - 1;
+                    if (i == 0 || uniqueRank[i] != uniqueRank[i - 1]) {
+                        m_dag[outIndex] = sortedLevel[i];
                     }
 
                     // construct indirection list
-                    indirectionList[indexList[level.index + i]] = globalOffset - 1;
+                    indirectionList[levelIndexList[i]] = outIndex;
                 }
+                if (level.count > 0) {
+                    outLevel.count = uniqueRank[level.count - 1];
+                    globalOffset += outLevel.count;
+                }
+                timeCompact += lap(phase);
 
                 if (l + 1 < m_dagLevels.size()) {
                     // update parent pointer in level l + 1
                     const auto &nextLevel = m_dagLevels[l + 1];
-                    for (uint32_t i = 0; i < nextLevel.count; i++) {
+#pragma omp parallel for if (nextLevel.count >= PARALLEL_MIN_COUNT)
+                    for (int64_t i = 0; i < static_cast<int64_t>(nextLevel.count); i++) {
                         auto &node = m_dag[nextLevel.index + i];
                         const bool isLeaf = node.isLeaf();
                         node.child0 = isLeaf ? node.child0 : indirectionList[node.child0];
@@ -174,18 +252,20 @@ namespace raven {
                     }
                 } else {
                     // update root pointer
-                    for (uint32_t i = 0; i < m_dagRootCount; i++) {
+#pragma omp parallel for if (m_dagRootCount >= PARALLEL_MIN_COUNT)
+                    for (int64_t i = 0; i < static_cast<int64_t>(m_dagRootCount); i++) {
                         assert(m_dagRoot[i] < m_dagCount);
                         m_dagRoot[i] = m_dagRoot[i] == invalidPointer() ? invalidPointer() : indirectionList[m_dagRoot[i]];
                     }
                 }
+                timePointer += lap(phase);
 
                 std::cout << "[DAG] Reduced level " << l << "." << std::endl;
             }
 
             std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
             double cpuTime = (static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) * std::pow(10, -3));
-            std::cout << "[DAG] " << cpuTime << "[ms]" << std::endl;
+            std::cout << "[DAG] " << cpuTime << "[ms] (sort " << timeSort << "[ms], gather " << timeGather << "[ms], compact " << timeCompact << "[ms], pointer update " << timePointer << "[ms])" << std::endl;
 
             uint32_t index = 0;
             for (uint32_t i = 0; i < outDAGLevels.size(); i++) {
@@ -221,6 +301,13 @@ namespace raven {
         }
 
     private:
+        static constexpr uint32_t PARALLEL_MIN_COUNT = 1 << 14; // smaller loops are run sequentially, per label reductions run concurrently anyway
+
+        struct KeyIndex {
+            uint64_t key;
+            uint32_t index;
+        };
+
         DAGRoot *m_dagRoot;
         uint32_t m_dagRootCount;
 
@@ -228,6 +315,40 @@ namespace raven {
         uint32_t m_dagCount = 0;
         std::vector<DAGLevel> m_dagLevels;
 
+        /**
+         * Writes the node indices of the level to outIndexList such that equal nodes are consecutive.
+         * Nodes are ordered by hash, nodes sharing a hash are ordered lexicographically such that hash collisions cannot separate duplicates.
+         */
+        void radixSortLevel(const DAGLevel &level, uint32_t *outIndexList, std::vector<KeyIndex> &keys, std::vector<KeyIndex> &keysScratch) const {
+            keys.resize(level.count);
+#pragma omp parallel for if (level.count >= PARALLEL_MIN_COUNT)
+            for (int64_t i = 0; i < static_cast<int64_t>(level.count); i++) {
+                keys[i] = {m_dag[level.index + i].hash(), static_cast<uint32_t>(level.index + i)};
+            }
+
+            RadixSort::sort(keys, keysScratch, [](const KeyIndex &keyIndex) { return keyIndex.key; });
+
+            // resolve runs of equal hashes
+            uint32_t runBegin = 0;
+            bool mixedRun = false;
+            for (uint32_t i = 1; i <= level.count; i++) {
+                if (i < level.count && keys[i].key == keys[runBegin].key) {
+                    mixedRun |= !m_dag[keys[i].index].equals(m_dag[keys[runBegin].index]);
+                    continue;
+                }
+                if (mixedRun) {
+                    std::sort(keys.begin() + runBegin, keys.begin() + i, [this](const KeyIndex &a, const KeyIndex &b) { return m_dag[a.index].lexicographicCompare(m_dag[b.index]); });
+                }
+                runBegin = i;
+                mixedRun = false;
+            }
+
+#pragma omp parallel for if (level.count >= PARALLEL_MIN_COUNT)
+            for (int64_t i = 0; i < static_cast<int64_t>(level.count); i++) {
+                outIndexList[i] = keys[i].index;
+            }
+        }
+
         bool verifyTraverse(std::vector<bool> &visited, const uint32_t index, const uint32_t level) {
             if (index >= m_dagCount && index != invalidPointer()) {
                 std::cerr << "DAG node index out of bounds." << std::endl;
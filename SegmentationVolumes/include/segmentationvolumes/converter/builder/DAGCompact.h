@@ -0,0 +1,216 @@
+#pragma once
+
+#include "DAG.h"
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace raven {
+    /**
+     * Variable-size encoding of an SVDAG (see DAG::DAGNode) as a stream of 32bit words:
+     * - inner node: [ child mask (bits 0-7) | pointer to child c for every set bit c in ascending order ]
+     * - leaf:       [ LEAF_FLAG | child1 | child2 ] (solid flag or 4^3 occupancy field)
+     * Pointers are word offsets into the stream. Children that are empty leaves are not stored, their mask bit is cleared and they are decoded as EMPTY_CHILD.
+     * The pointer to child c is the word 1 + popcount(mask & ((1 << c) - 1)) of the node.
+     *
+     * With a leaf table, the leaves are not stored as nodes, but as deduplicated 64bit fields (child1 << 32 | child2) in a packed table at the start of the stream:
+     * [ LEAF_TABLE_FLAG | number of fields | field 0 | field 1 | ... | inner nodes ], pointers to leaves are the word offset of the field tagged with LEAF_POINTER.
+     * Since the leaves of an occupancy field SVDAG are its most numerous nodes, a leaf takes 8 instead of 12 bytes (32 bytes as DAG::DAGNode).
+     *
+     * The nodes keep the order of the input SVDAG (children before parents), i.e. the pointers of a stream can be relocated by a single pass over the stream.
+     */
+    class DAGCompact {
+    public:
+        static constexpr uint32_t CHILD_MASK = 0xFF;
+        static constexpr uint32_t LEAF_FLAG = 1u << 8;
+        static constexpr uint32_t LEAF_TABLE_FLAG = 1u << 9;
+        static constexpr uint32_t LEAF_WORDS = 3;
+        static constexpr uint32_t LEAF_POINTER = 1u << 31;
+        // must differ from DAG::invalidPointer(), which marks a decoded node as leaf (see decode), and is thus the largest untagged word offset
+        static constexpr uint32_t EMPTY_CHILD = LEAF_POINTER - 1;
+        static constexpr uint64_t MAX_WORDS = EMPTY_CHILD; // word offsets are 31bit, the upper bit tags leaf pointers
+
+        [[nodiscard]] static bool isEmptyLeaf(const DAG::DAGNode &node) { return node.isLeaf() && !node.isSolid(); }
+
+        [[nodiscard]] static uint64_t leafField(const DAG::DAGNode &node) { return (static_cast<uint64_t>(node.child1) << 32) | node.child2; }
+
+        [[nodiscard]] static uint32_t nodeWords(const uint32_t header) {
+            return (header & LEAF_FLAG) != 0 ? LEAF_WORDS : 1 + std::popcount(header & CHILD_MASK);
+        }
+
+        // word offset of the first node, i.e. behind the leaf table
+        [[nodiscard]] static uint64_t firstNode(const uint32_t *words, const uint64_t numWords) {
+            return numWords > 0 && (words[0] & LEAF_TABLE_FLAG) != 0 ? 2 + 2 * static_cast<uint64_t>(words[1]) : 0;
+        }
+
+        /**
+         * Decodes the node at pointer into a DAG::DAGNode exactly like svdag_fetchCompactNode, i.e. leaves have child0 == DAG::invalidPointer()
+         * and the children of inner nodes are pointers of the stream or EMPTY_CHILD.
+         */
+        [[nodiscard]] static DAG::DAGNode decode(const uint32_t *words, const uint32_t pointer) {
+            DAG::DAGNode node;
+            if (pointer == EMPTY_CHILD) {
+                node.child1 = 0;
+                node.child2 = 0;
+                return node;
+            }
+            if ((pointer & LEAF_POINTER) != 0) {
+                // field of the leaf table, lower word first
+                const uint32_t field = pointer & ~LEAF_POINTER;
+                node.child1 = words[field + 1];
+                node.child2 = words[field];
+                return node;
+            }
+            const uint32_t header = words[pointer];
+            if ((header & LEAF_FLAG) != 0) {
+                node.child1 = words[pointer + 1];
+                node.child2 = words[pointer + 2];
+                return node;
+            }
+            uint32_t children[8];
+            for (uint32_t c = 0; c < 8; c++) {
+                children[c] = (header & (1u << c)) != 0 ? words[pointer + 1 + std::popcount(header & ((1u << c) - 1))] : EMPTY_CHILD;
+            }
+            return {children[0], children[1], children[2], children[3], children[4], children[5], children[6], children[7]};
+        }
+
+        /**
+         * Encodes the SVDAG into outWords, outPointers holds the pointer to every input node (roots are remapped with it).
+         */
+        static void encode(const std::vector<DAG::DAGNode> &dag, const bool leafTable, std::vector<uint32_t> &outWords, std::vector<uint32_t> &outPointers) {
+            outWords.clear();
+            outPointers.resize(dag.size());
+
+            if (leafTable) {
+                std::unordered_map<uint64_t, uint32_t> fields; // field -> pointer
+                std::vector<uint64_t> table;
+                for (uint64_t i = 0; i < dag.size(); i++) {
+                    if (!dag[i].isLeaf() || isEmptyLeaf(dag[i])) {
+                        continue;
+                    }
+                    const auto [field, inserted] = fields.try_emplace(leafField(dag[i]), static_cast<uint32_t>(LEAF_POINTER | (2 + 2 * table.size())));
+                    if (inserted) {
+                        table.push_back(field->first);
+                    }
+                    outPointers[i] = field->second;
+                }
+                if (2 + 2 * table.size() > MAX_WORDS) {
+                    throw std::runtime_error("Compact SVDAG leaf table exceeds 31bit word pointers.");
+                }
+                outWords.resize(2 + 2 * table.size());
+                outWords[0] = LEAF_TABLE_FLAG;
+                outWords[1] = static_cast<uint32_t>(table.size());
+                std::memcpy(outWords.data() + 2, table.data(), table.size() * sizeof(uint64_t));
+            }
+
+            for (uint64_t i = 0; i < dag.size(); i++) {
+                const auto &node = dag[i];
+                if (isEmptyLeaf(node)) {
+                    outPointers[i] = EMPTY_CHILD;
+                    continue;
+                }
+                if (node.isLeaf() && leafTable) {
+                    continue;
+                }
+                if (outWords.size() + 9 > MAX_WORDS) {
+                    throw std::runtime_error("Compact SVDAG exceeds 31bit word pointers.");
+                }
+                outPointers[i] = static_cast<uint32_t>(outWords.size());
+                if (node.isLeaf()) {
+                    outWords.insert(outWords.end(), {LEAF_FLAG, node.child1, node.child2});
+                    continue;
+                }
+                const uint32_t children[8] = {node.child0, node.child1, node.child2, node.child3, node.child4, node.child5, node.child6, node.child7};
+                const uint64_t header = outWords.size();
+                outWords.push_back(0);
+                for (uint32_t c = 0; c < 8; c++) {
+                    if (children[c] >= i) {
+                        throw std::runtime_error("SVDAG node " + std::to_string(i) + " does not point to a lower level.");
+                    }
+                    if (isEmptyLeaf(dag[children[c]])) {
+                        continue;
+                    }
+                    outWords[header] |= 1u << c;
+                    outWords.push_back(outPointers[children[c]]);
+                }
+            }
+        }
+
+        // decodes every node of the stream like the shaders do (see decode) and compares it to its input node
+        static void verify(const std::vector<DAG::DAGNode> &dag, const std::vector<uint32_t> &words, const std::vector<uint32_t> &pointers) {
+            for (uint64_t i = 0; i < dag.size(); i++) {
+                const auto &node = dag[i];
+                const uint32_t pointer = pointers[i];
+                const DAG::DAGNode decoded = decode(words.data(), pointer);
+                bool valid = decoded.isLeaf() == node.isLeaf();
+                if (valid && node.isLeaf()) {
+                    valid = decoded.isSolid() == node.isSolid() && leafField(decoded) == (isEmptyLeaf(node) ? 0 : leafField(node));
+                } else if (valid) {
+                    const uint32_t children[8] = {node.child0, node.child1, node.child2, node.child3, node.child4, node.child5, node.child6, node.child7};
+                    const uint32_t decodedChildren[8] = {decoded.child0, decoded.child1, decoded.child2, decoded.child3, decoded.child4, decoded.child5, decoded.child6, decoded.child7};
+                    for (uint32_t c = 0; c < 8 && valid; c++) {
+                        valid = decodedChildren[c] == pointers[children[c]];
+                    }
+                }
+                if (!valid) {
+                    throw std::runtime_error("Compact SVDAG pointer " + std::to_string(pointer) + " does not match SVDAG node " + std::to_string(i) + ".");
+                }
+            }
+        }
+
+        // adds offset to all pointers of the stream, e.g. if the stream is placed at word offset of a LOD buffer, offset + numWords must not exceed MAX_WORDS
+        static void relocate(uint32_t *words, const uint64_t numWords, const uint32_t offset) {
+            for (uint64_t node = firstNode(words, numWords); node < numWords; node += nodeWords(words[node])) {
+                if ((words[node] & LEAF_FLAG) != 0) {
+                    continue;
+                }
+                const uint32_t numChildren = std::popcount(words[node] & CHILD_MASK);
+                for (uint32_t c = 1; c <= numChildren; c++) {
+                    words[node + c] = relocatePointer(words[node + c], offset);
+                }
+            }
+        }
+
+        // relocates a child or root pointer of a stream placed at word offset: EMPTY_CHILD and DAG::invalidPointer() are kept, leaf pointers keep their LEAF_POINTER tag
+        [[nodiscard]] static uint32_t relocatePointer(const uint32_t pointer, const uint32_t offset) {
+            if (pointer == EMPTY_CHILD || pointer == DAG::invalidPointer()) {
+                return pointer;
+            }
+            return (pointer & LEAF_POINTER) | ((pointer & ~LEAF_POINTER) + offset);
+        }
+
+        /**
+         * CPU reference traversal on the nodes as decoded by the shaders: returns whether the voxel (x, y, z) \in [0, 16)^3 of the 16^3 SVDAG at root is solid.
+         * With occupancyField, the leaves of extent 4 are 4^3 occupancy fields (bit z * 16 + y * 4 + x of child1 << 32 | child2).
+         */
+        [[nodiscard]] static bool isSolid(const uint32_t *words, uint32_t pointer, const uint32_t x, const uint32_t y, const uint32_t z, const bool occupancyField) {
+            uint32_t extent = 16;
+            uint32_t anchorX = 0;
+            uint32_t anchorY = 0;
+            uint32_t anchorZ = 0;
+            DAG::DAGNode node = decode(words, pointer);
+            while (!node.isLeaf()) {
+                extent >>= 1;
+                // ZYX child index
+                const uint32_t cx = x >= anchorX + extent ? 1 : 0;
+                const uint32_t cy = y >= anchorY + extent ? 1 : 0;
+                const uint32_t cz = z >= anchorZ + extent ? 1 : 0;
+                anchorX += cx * extent;
+                anchorY += cy * extent;
+                anchorZ += cz * extent;
+                const uint32_t children[8] = {node.child0, node.child1, node.child2, node.child3, node.child4, node.child5, node.child6, node.child7};
+                node = decode(words, children[(cz << 2) | (cy << 1) | cx]);
+            }
+            const uint64_t field = leafField(node);
+            if (occupancyField && extent == 4) {
+                return ((field >> ((z - anchorZ) * 16 + (y - anchorY) * 4 + (x - anchorX))) & 1) != 0;
+            }
+            return field > 0;
+        }
+    };
+} // namespace raven
@@ -0,0 +1,247 @@
+#pragma once
+
+#include "DAG.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace raven {
+    /**
+     * Out-of-core variant of combining and reducing DAGs (SegmentationVolumeConverter::loadDAGsCombine + DAG::reduce) for pools that do not fit into memory.
+     * Levels are reduced bottom up, one at a time:
+     * - the nodes of the level are streamed from all inputs, their child pointers are remapped with the indirection map of the lower levels
+     * - (node, index) records are collected up to the memory cap, sorted lexicographically and spilled to disk as sorted runs
+     * - the runs are merged with a k-way merge, the first node of each run of equal nodes is written to the output and the indirection map is updated
+     * The indirection map (one 32bit entry per input node) is a memory-mapped file in the temporary directory, the maximum pool size is limited by disk space.
+     * The reduced levels are in DAG::SORT_ORDER_LEXICOGRAPHIC.
+     */
+    class DAGExternalReduce {
+    public:
+        struct Input {
+            std::string m_lod;
+            std::vector<DAG::DAGLevel> m_levels;
+        };
+
+        DAGExternalReduce(std::string tempDirectory, const uint64_t memoryCap) : m_tempDirectory(std::move(tempDirectory)), m_memoryCap(memoryCap) {}
+
+        ~DAGExternalReduce() {
+            m_indirection.close();
+            std::filesystem::remove(m_tempDirectory + "/indirection.bin");
+            std::error_code error;
+            std::filesystem::remove(m_tempDirectory, error); // only removed if empty
+        }
+
+        void reduce(const std::vector<Input> &inputs, const std::string &outLOD, std::vector<DAG::DAGLevel> &outDAGLevels) {
+            std::filesystem::create_directories(m_tempDirectory);
+
+            const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+            uint64_t numLevels = 0;
+            m_inputOffset.assign(inputs.size(), 0);
+            uint64_t inDAGCount = 0;
+            for (uint64_t i = 0; i < inputs.size(); i++) {
+                m_inputOffset[i] = inDAGCount;
+                for (const auto &level: inputs[i].m_levels) {
+                    inDAGCount += level.count;
+                }
+                numLevels = std::max(numLevels, static_cast<uint64_t>(inputs[i].m_levels.size()));
+            }
+            m_indirection.create(m_tempDirectory + "/indirection.bin", inDAGCount * sizeof(uint32_t));
+
+            const uint64_t runCapacity = std::max(MIN_RUN_RECORDS, m_memoryCap / sizeof(Record));
+            std::cout << "[DAGExternalReduce] " << inDAGCount << " nodes, " << numLevels << " levels, " << runCapacity << " records per run." << std::endl;
+
+            std::ofstream out(outLOD, std::ios::binary);
+            outDAGLevels.assign(numLevels, {});
+            uint64_t globalOffset = 0;
+            std::vector<Record> run;
+            std::vector<DAG::DAGNode> readBuffer(READ_BUFFER_NODES);
+
+            for (uint32_t l = 0; l < numLevels; l++) {
+                auto &outLevel = outDAGLevels[l];
+                outLevel.index = static_cast<uint32_t>(globalOffset);
+                outLevel.count = 0;
+
+                // sorted runs
+                std::vector<std::string> runFiles;
+                run.clear();
+                for (uint64_t i = 0; i < inputs.size(); i++) {
+                    if (l >= inputs[i].m_levels.size()) {
+                        continue;
+                    }
+                    const auto &level = inputs[i].m_levels[l];
+                    std::ifstream in(inputs[i].m_lod, std::ios::binary);
+                    in.seekg(static_cast<std::streamoff>(level.index) * static_cast<std::streamoff>(sizeof(DAG::DAGNode)));
+                    for (uint32_t first = 0; first < level.count; first += READ_BUFFER_NODES) {
+                        const uint32_t count = std::min(READ_BUFFER_NODES, level.count - first);
+                        in.read(reinterpret_cast<char *>(readBuffer.data()), static_cast<std::streamsize>(count * sizeof(DAG::DAGNode)));
+                        if (!in) {
+                            throw std::runtime_error("DAGExternalReduce: Failed to read " + inputs[i].m_lod + ".");
+                        }
+                        for (uint32_t j = 0; j < count; j++) {
+                            run.push_back({remapNode(i, readBuffer[j]), m_inputOffset[i] + level.index + first + j});
+                            if (run.size() == runCapacity) {
+                                runFiles.push_back(spillRun(run, l, runFiles.size()));
+                            }
+                        }
+                    }
+                }
+
+                // merge runs
+                const auto emit = [&](const Record &record, const bool unique) {
+                    if (unique) {
+                        if (globalOffset >= DAG::invalidPointer()) {
+                            throw std::runtime_error("DAGExternalReduce: Reduced DAG exceeds 32bit node pointers.");
+                        }
+                        out.write(reinterpret_cast<const char *>(&record.node), sizeof(DAG::DAGNode));
+                        globalOffset++;
+                        outLevel.count++;
+                    }
+                    m_indirection.data<uint32_t>()[record.index] = static_cast<uint32_t>(globalOffset - 1);
+                };
+                if (runFiles.empty()) {
+                    sortRun(run);
+                    for (uint64_t i = 0; i < run.size(); i++) {
+                        emit(run[i], i == 0 || !run[i].node.equals(run[i - 1].node));
+                    }
+                } else {
+                    if (!run.empty()) {
+                        runFiles.push_back(spillRun(run, l, runFiles.size()));
+                    }
+                    run.clear();
+                    run.shrink_to_fit();
+                    mergeRuns(runFiles, emit);
+                    for (const auto &runFile: runFiles) {
+                        std::filesystem::remove(runFile);
+                    }
+                }
+
+                std::cout << "[DAGExternalReduce] Reduced level " << l << " (" << std::max<size_t>(1, runFiles.size()) << " run(s)): " << outLevel.count << " nodes." << std::endl;
+            }
+
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+            double cpuTime = (static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) * std::pow(10, -3));
+            std::cout << "[DAGExternalReduce] " << cpuTime << "[ms]" << std::endl;
+            std::cout << "[DAGExternalReduce] Reduced from " << inDAGCount << " to " << globalOffset << " nodes." << std::endl;
+        }
+
+        // reduced node index of a node of an input, valid after reduce()
+        [[nodiscard]] uint32_t remap(const uint64_t input, const uint32_t pointer) const {
+            return pointer == DAG::invalidPointer() ? DAG::invalidPointer() : m_indirection.data<uint32_t>()[m_inputOffset[input] + pointer];
+        }
+
+    private:
+        struct Record {
+            DAG::DAGNode node;
+            uint64_t index; // index of the node in the combined input
+        };
+
+        static constexpr uint64_t MIN_RUN_RECORDS = 1 << 16;
+        static constexpr uint32_t READ_BUFFER_NODES = 1 << 14;
+        static constexpr uint64_t MIN_MERGE_BUFFER_RECORDS = 1 << 10;
+
+        std::string m_tempDirectory;
+        uint64_t m_memoryCap;
+
+        MappedFile m_indirection;         // combined input index -> reduced index
+        std::vector<uint64_t> m_inputOffset; // offset of each input in the combined input
+
+        [[nodiscard]] DAG::DAGNode remapNode(const uint64_t input, DAG::DAGNode node) const {
+            if (!node.isLeaf()) {
+                node.child0 = remap(input, node.child0);
+                node.child1 = remap(input, node.child1);
+                node.child2 = remap(input, node.child2);
+                node.child3 = remap(input, node.child3);
+                node.child4 = remap(input, node.child4);
+                node.child5 = remap(input, node.child5);
+                node.child6 = remap(input, node.child6);
+                node.child7 = remap(input, node.child7);
+            }
+            return node;
+        }
+
+        static bool compare(const Record &a, const Record &b) {
+            return a.node.lexicographicCompare(b.node) || (a.node.equals(b.node) && a.index < b.index);
+        }
+
+        static void sortRun(std::vector<Record> &run) {
+            std::sort(std::execution::par_unseq, run.begin(), run.end(), compare);
+        }
+
+        std::string spillRun(std::vector<Record> &run, const uint32_t level, const uint64_t runIndex) const {
+            sortRun(run);
+            const std::string file = m_tempDirectory + "/run_" + std::to_string(level) + "_" + std::to_string(runIndex) + ".bin";
+            std::ofstream(file, std::ios::binary).write(reinterpret_cast<const char *>(run.data()), static_cast<std::streamsize>(run.size() * sizeof(Record)));
+            run.clear();
+            return file;
+        }
+
+        template<typename Emit>
+        void mergeRuns(const std::vector<std::string> &runFiles, Emit emit) const {
+            struct RunReader {
+                std::ifstream file;
+                uint64_t remaining = 0;
+                std::vector<Record> buffer;
+                uint64_t position = 0;
+
+                bool fill() {
+                    if (position < buffer.size()) {
+                        return true;
+                    }
+                    if (remaining == 0) {
+                        return false;
+                    }
+                    buffer.resize(std::min<uint64_t>(buffer.capacity(), remaining));
+                    file.read(reinterpret_cast<char *>(buffer.data()), static_cast<std::streamsize>(buffer.size() * sizeof(Record)));
+                    remaining -= buffer.size();
+                    position = 0;
+                    return true;
+                }
+            };
+
+            const uint64_t bufferRecords = std::max(MIN_MERGE_BUFFER_RECORDS, m_memoryCap / (runFiles.size() * sizeof(Record)));
+            std::vector<RunReader> readers(runFiles.size());
+            std::vector<uint32_t> heap;
+            for (uint32_t i = 0; i < runFiles.size(); i++) {
+                readers[i].file.open(runFiles[i], std::ios::binary);
+                readers[i].remaining = std::filesystem::file_size(runFiles[i]) / sizeof(Record);
+                readers[i].buffer.reserve(bufferRecords);
+                if (readers[i].fill()) {
+                    heap.push_back(i);
+                }
+            }
+
+            const auto greater = [&readers](const uint32_t a, const uint32_t b) { return compare(readers[b].buffer[readers[b].position], readers[a].buffer[readers[a].position]); };
+            std::make_heap(heap.begin(), heap.end(), greater);
+
+            bool first = true;
+            DAG::DAGNode last{};
+            while (!heap.empty()) {
+                std::pop_heap(heap.begin(), heap.end(), greater);
+                auto &reader = readers[heap.back()];
+                const Record record = reader.buffer[reader.position++];
+
+                emit(record, first || !record.node.equals(last));
+                first = false;
+                last = record.node;
+
+                if (reader.fill()) {
+                    std::push_heap(heap.begin(), heap.end(), greater);
+                } else {
+                    heap.pop_back();
+                }
+            }
+        }
+    };
+} // namespace raven
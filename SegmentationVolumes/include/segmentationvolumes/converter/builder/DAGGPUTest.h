@@ -13,11 +13,19 @@
 namespace raven {
     class DAGGPUTest {
     public:
-        static void test(const std::string &data, const std::string &scene, const std::vector<SegmentationVolumeConverter::DAGFileInfo> &dagFileInfos, const std::string &prefixPlural, const std::string &outputFolder) {
-            std::vector<DAG::DAGRoot> dagRoot;
-            std::vector<DAG::DAGNode> dag;
-            std::vector<DAG::DAGLevel> dagLevels;
-            SegmentationVolumeConverter::loadDAGsCombine(data, scene, dagFileInfos, dagRoot, dag, dagLevels);
+        // reduces every merge segment (see SegmentationVolumeConverter::mergeSegments) on the GPU and writes it as <prefixPlural>[_<segment>]
+        static void test(const std::string &data, const std::string &scene, const std::vector<std::vector<SegmentationVolumeConverter::DAGFileInfo>> &segments, const std::string &prefixPlural, const std::string &outputFolder) {
+            std::vector<SegmentationVolumeConverter::DAGPool> pools = SegmentationVolumeConverter::loadDAGsCombine(data, scene, segments);
+            for (uint64_t segment = 0; segment < segments.size(); segment++) {
+                testSegment(data, scene, segments[segment], pools[segment], SegmentationVolumeConverter::mergedName(prefixPlural, segments.size(), segment), outputFolder);
+            }
+        }
+
+        static void testSegment(const std::string &data, const std::string &scene, const std::vector<SegmentationVolumeConverter::DAGFileInfo> &dagFileInfos, SegmentationVolumeConverter::DAGPool &pool, const std::string &name,
+                                const std::string &outputFolder) {
+            auto &dagRoot = pool.m_dagRoot;
+            auto &dag = pool.m_dag;
+            auto &dagLevels = pool.m_dagLevels;
 
             DAG dagConstruct(dagRoot.data(), dagRoot.size(), dag.data(), dag.size(), dagLevels);
             std::cout << "[DAG] Start verification." << std::endl;
@@ -72,8 +80,8 @@ namespace raven {
                 }
             }
 
-            std::ofstream(data + "/" + scene + "/" + outputFolder + "/lod/" + prefixPlural + ".bin", std::ios::binary).write(reinterpret_cast<char *>(dagNew.data()), static_cast<std::streamsize>(dagNew.size() * sizeof(DAG::DAGNode)));
-            std::ofstream(data + "/" + scene + "/" + outputFolder + "/lod_data/" + prefixPlural + ".bin", std::ios::binary).write(reinterpret_cast<char *>(dagLevelsNew.data()), static_cast<std::streamsize>(dagLevelsNew.size() * sizeof(DAG::DAGLevel)));
+            std::ofstream(data + "/" + scene + "/" + outputFolder + "/lod/" + name + ".bin", std::ios::binary).write(reinterpret_cast<char *>(dagNew.data()), static_cast<std::streamsize>(dagNew.size() * sizeof(DAG::DAGNode)));
+            std::ofstream(data + "/" + scene + "/" + outputFolder + "/lod_data/" + name + ".bin", std::ios::binary).write(reinterpret_cast<char *>(dagLevelsNew.data()), static_cast<std::streamsize>(dagLevelsNew.size() * sizeof(DAG::DAGLevel)));
         }
 
         static uint32_t sectionUpdatePointer(const uint64_t volume, const uint64_t pointer, const std::vector<DAG::DAGLevel> &dagLevels, const std::vector<std::vector<DAG::DAGLevel>> &offsetDAGLevels,
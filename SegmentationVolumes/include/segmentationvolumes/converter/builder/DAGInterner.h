@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <tbb/concurrent_hash_map.h>
+#include <tbb/concurrent_vector.h>
+
+namespace raven {
+    /**
+     * Hash consing of DAG nodes during construction. Every level owns a concurrent hash table from node to index and a concurrent node array.
+     * intern() returns the index of an equal node if it has already been inserted into the level, otherwise the node is appended.
+     * - nodes are compared bytewise, Node must not contain padding
+     * - intern() may be called concurrently, the order of the nodes within a level then depends on the scheduling of the threads
+     * - the interner can be used in place of std::vector<std::vector<Node>>, levels are indexed with operator[]
+     */
+    template<typename Node>
+    class DAGInterner {
+    public:
+        explicit DAGInterner(const uint32_t maxLevels) {
+            m_levels.reserve(maxLevels);
+            for (uint32_t i = 0; i < maxLevels; i++) {
+                m_levels.push_back(std::make_unique<Level>());
+            }
+        }
+
+        uint32_t intern(const uint32_t level, const Node &node) {
+            if (level >= m_levels.size()) {
+                throw std::runtime_error("DAGInterner: level " + std::to_string(level) + " exceeds maximum level count " + std::to_string(m_levels.size()) + ".");
+            }
+            auto &l = *m_levels[level];
+            typename Map::accessor accessor;
+            if (l.map.insert(accessor, node)) {
+                accessor->second = static_cast<uint32_t>(l.nodes.push_back(node) - l.nodes.begin());
+            }
+            return accessor->second;
+        }
+
+        // number of levels up to the highest non-empty level
+        [[nodiscard]] size_t size() const {
+            for (size_t i = m_levels.size(); i > 0; i--) {
+                if (!m_levels[i - 1]->nodes.empty()) {
+                    return i;
+                }
+            }
+            return 0;
+        }
+
+        [[nodiscard]] const tbb::concurrent_vector<Node> &operator[](const size_t level) const { return m_levels[level]->nodes; }
+
+    private:
+        struct HashCompare {
+            static size_t hash(const Node &node) {
+                const auto *bytes = reinterpret_cast<const unsigned char *>(&node);
+                uint64_t h = 0xcbf29ce484222325ull; // FNV-1a
+                for (size_t i = 0; i < sizeof(Node); i++) {
+                    h = (h ^ bytes[i]) * 0x100000001b3ull;
+                }
+                return h ^ (h >> 32);
+            }
+
+            static bool equal(const Node &a, const Node &b) {
+                return std::memcmp(&a, &b, sizeof(Node)) == 0;
+            }
+        };
+
+        typedef tbb::concurrent_hash_map<Node, uint32_t, HashCompare> Map;
+
+        struct Level {
+            Map map;
+            tbb::concurrent_vector<Node> nodes;
+        };
+
+        std::vector<std::unique_ptr<Level>> m_levels;
+    };
+} // namespace raven
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "../SegmentationVolumeConverter.h"
+#include "DAG.h"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace raven {
+    /**
+     * Compares the reduce modes of DAG::reduce on the combined (not yet merged) DAGs of a scene, every merge segment (see SegmentationVolumeConverter::mergeSegments) on its own.
+     * Every mode reduces its own copy of the input, the results are verified and checked for equivalence against the first mode.
+     */
+    class DAGReduceBenchmark {
+    public:
+        static void benchmark(const std::string &data, const std::string &scene, const std::vector<std::vector<SegmentationVolumeConverter::DAGFileInfo>> &segments, const uint32_t iterations = 3) {
+            const std::vector<SegmentationVolumeConverter::DAGPool> pools = SegmentationVolumeConverter::loadDAGsCombine(data, scene, segments);
+            for (uint64_t segment = 0; segment < pools.size(); segment++) {
+                std::cout << "[DAGReduceBenchmark] Segment " << segment << " of " << pools.size() << "." << std::endl;
+                benchmarkSegment(pools[segment], iterations);
+            }
+        }
+
+        static void benchmarkSegment(const SegmentationVolumeConverter::DAGPool &pool, const uint32_t iterations) {
+            const auto &inDAGRoot = pool.m_dagRoot;
+            const auto &inDAG = pool.m_dag;
+            const auto &inDAGLevels = pool.m_dagLevels;
+
+            std::cout << "[DAGReduceBenchmark] " << inDAG.size() << " nodes, " << inDAGRoot.size() << " roots, " << inDAGLevels.size() << " levels." << std::endl;
+            for (uint32_t l = 0; l < inDAGLevels.size(); l++) {
+                std::cout << "[DAGReduceBenchmark] Level " << l << ": " << inDAGLevels[l].count << " nodes." << std::endl;
+            }
+
+            const std::vector<std::pair<DAG::ReduceMode, std::string>> modes = {{DAG::REDUCE_MODE_HASH_COMPARATOR, "hash comparator"}, {DAG::REDUCE_MODE_RADIX_SORT, "radix sort"}, {DAG::REDUCE_MODE_LEXICOGRAPHIC, "lexicographic"}};
+
+            std::vector<DAG::DAGRoot> referenceDAGRoot;
+            std::vector<DAG::DAGNode> referenceDAG;
+            uint32_t referenceDAGCount = 0;
+
+            for (uint32_t m = 0; m < modes.size(); m++) {
+                const auto &[mode, name] = modes[m];
+
+                std::vector<DAG::DAGRoot> dagRoot;
+                std::vector<DAG::DAGNode> dag;
+                uint32_t outDAGCount = 0;
+                std::vector<DAG::DAGLevel> outDAGLevels(inDAGLevels.size());
+
+                double minTime = std::numeric_limits<double>::max();
+                double totalTime = 0;
+                for (uint32_t i = 0; i < iterations; i++) {
+                    dagRoot = inDAGRoot;
+                    dag = inDAG;
+
+                    DAG dagConstruct(dagRoot.data(), dagRoot.size(), dag.data(), dag.size(), inDAGLevels);
+                    const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+                    dagConstruct.reduce(&outDAGCount, outDAGLevels, mode);
+                    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+                    const double cpuTime = (static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) * std::pow(10, -3));
+                    minTime = std::min(minTime, cpuTime);
+                    totalTime += cpuTime;
+                }
+
+                DAG dagVerify(dagRoot.data(), dagRoot.size(), dag.data(), outDAGCount, outDAGLevels);
+                dagVerify.verify();
+
+                if (m == 0) {
+                    referenceDAGRoot = dagRoot;
+                    referenceDAG = dag;
+                    referenceDAGCount = outDAGCount;
+                } else if (!equivalent(referenceDAGRoot, referenceDAG, referenceDAGCount, dagRoot, dag, outDAGCount)) {
+                    throw std::runtime_error("DAGReduceBenchmark: " + name + " result differs from " + modes[0].second + " result.");
+                }
+
+                std::cout << "[DAGReduceBenchmark] " << name << ": " << outDAGCount << " nodes, min " << minTime << "[ms], avg " << totalTime / iterations << "[ms]." << std::endl;
+            }
+        }
+
+    private:
+        /**
+         * Two reduced DAGs are equivalent if every root describes the same volume.
+         * Each node of a has to correspond to exactly one node of b, b may contain less nodes if a missed duplicates.
+         */
+        static bool equivalent(const std::vector<DAG::DAGRoot> &rootA, const std::vector<DAG::DAGNode> &dagA, const uint32_t dagCountA,
+                               const std::vector<DAG::DAGRoot> &rootB, const std::vector<DAG::DAGNode> &dagB, const uint32_t dagCountB) {
+            if (rootA.size() != rootB.size() || dagCountA < dagCountB) {
+                return false;
+            }
+            std::vector<uint32_t> correspondence(dagCountA, DAG::invalidPointer());
+            for (uint32_t i = 0; i < rootA.size(); i++) {
+                if ((rootA[i] == DAG::invalidPointer()) != (rootB[i] == DAG::invalidPointer())) {
+                    return false;
+                }
+                if (rootA[i] != DAG::invalidPointer() && !equivalentTraverse(dagA, dagB, correspondence, rootA[i], rootB[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static bool equivalentTraverse(const std::vector<DAG::DAGNode> &dagA, const std::vector<DAG::DAGNode> &dagB, std::vector<uint32_t> &correspondence, const uint32_t a, const uint32_t b) {
+            if (correspondence[a] != DAG::invalidPointer()) {
+                return correspondence[a] == b;
+            }
+            correspondence[a] = b;
+
+            const auto &nodeA = dagA[a];
+            const auto &nodeB = dagB[b];
+            if (nodeA.isLeaf() || nodeB.isLeaf()) {
+                return nodeA.equals(nodeB);
+            }
+            const uint32_t childrenA[8] = {nodeA.child0, nodeA.child1, nodeA.child2, nodeA.child3, nodeA.child4, nodeA.child5, nodeA.child6, nodeA.child7};
+            const uint32_t childrenB[8] = {nodeB.child0, nodeB.child1, nodeB.child2, nodeB.child3, nodeB.child4, nodeB.child5, nodeB.child6, nodeB.child7};
+            for (uint32_t i = 0; i < 8; i++) {
+                if ((childrenA[i] == DAG::invalidPointer()) != (childrenB[i] == DAG::invalidPointer())) {
+                    return false;
+                }
+                if (childrenA[i] != DAG::invalidPointer() && !equivalentTraverse(dagA, dagB, correspondence, childrenA[i], childrenB[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+} // namespace raven
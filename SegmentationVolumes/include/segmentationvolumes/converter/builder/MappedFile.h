@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace raven {
+    /**
+     * Read-write memory mapping of a file, the pages are written back to the file by the operating system.
+     * Used for arrays that may exceed the available memory.
+     */
+    class MappedFile {
+    public:
+        MappedFile() = default;
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        ~MappedFile() {
+            close();
+        }
+
+        // creates (or truncates) the file with the given size and maps it
+        void create(const std::string &path, const uint64_t sizeBytes) {
+            close();
+            m_sizeBytes = sizeBytes;
+            if (sizeBytes == 0) {
+                return;
+            }
+#ifdef _WIN32
+            m_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (m_file == INVALID_HANDLE_VALUE) {
+                throw std::runtime_error("MappedFile: Failed to create " + path + ".");
+            }
+            m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, static_cast<DWORD>(sizeBytes >> 32), static_cast<DWORD>(sizeBytes & 0xFFFFFFFF), nullptr);
+            if (m_mapping == nullptr) {
+                throw std::runtime_error("MappedFile: Failed to create mapping of " + path + ".");
+            }
+            m_data = MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+            if (m_data == nullptr) {
+                throw std::runtime_error("MappedFile: Failed to map " + path + ".");
+            }
+#else
+            const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                throw std::runtime_error("MappedFile: Failed to create " + path + ".");
+            }
+            if (ftruncate(fd, static_cast<off_t>(sizeBytes)) != 0) {
+                ::close(fd);
+                throw std::runtime_error("MappedFile: Failed to resize " + path + ".");
+            }
+            void *data = mmap(nullptr, sizeBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd); // the mapping keeps the file open
+            if (data == MAP_FAILED) {
+                throw std::runtime_error("MappedFile: Failed to map " + path + ".");
+            }
+            m_data = data;
+#endif
+        }
+
+        // maps the existing file with its current size, e.g. to update single entries of an array without reading and writing the whole file
+        void open(const std::string &path) {
+            close();
+#ifdef _WIN32
+            m_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (m_file == INVALID_HANDLE_VALUE) {
+                throw std::runtime_error("MappedFile: Failed to open " + path + ".");
+            }
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(m_file, &size)) {
+                throw std::runtime_error("MappedFile: Failed to query the size of " + path + ".");
+            }
+            m_sizeBytes = static_cast<uint64_t>(size.QuadPart);
+            if (m_sizeBytes == 0) {
+                return;
+            }
+            m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+            if (m_mapping == nullptr) {
+                throw std::runtime_error("MappedFile: Failed to create mapping of " + path + ".");
+            }
+            m_data = MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+            if (m_data == nullptr) {
+                throw std::runtime_error("MappedFile: Failed to map " + path + ".");
+            }
+#else
+            const int fd = ::open(path.c_str(), O_RDWR);
+            if (fd < 0) {
+                throw std::runtime_error("MappedFile: Failed to open " + path + ".");
+            }
+            const off_t size = lseek(fd, 0, SEEK_END);
+            if (size < 0) {
+                ::close(fd);
+                throw std::runtime_error("MappedFile: Failed to query the size of " + path + ".");
+            }
+            m_sizeBytes = static_cast<uint64_t>(size);
+            if (m_sizeBytes == 0) {
+                ::close(fd);
+                return;
+            }
+            void *data = mmap(nullptr, m_sizeBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd); // the mapping keeps the file open
+            if (data == MAP_FAILED) {
+                throw std::runtime_error("MappedFile: Failed to map " + path + ".");
+            }
+            m_data = data;
+#endif
+        }
+
+        void close() {
+#ifdef _WIN32
+            if (m_data != nullptr) {
+                UnmapViewOfFile(m_data);
+            }
+            if (m_mapping != nullptr) {
+                CloseHandle(m_mapping);
+            }
+            if (m_file != INVALID_HANDLE_VALUE) {
+                CloseHandle(m_file);
+            }
+            m_mapping = nullptr;
+            m_file = INVALID_HANDLE_VALUE;
+#else
+            if (m_data != nullptr) {
+                munmap(m_data, m_sizeBytes);
+            }
+#endif
+            m_data = nullptr;
+            m_sizeBytes = 0;
+        }
+
+        template<typename T>
+        [[nodiscard]] T *data() const { return static_cast<T *>(m_data); }
+
+        [[nodiscard]] uint64_t sizeBytes() const { return m_sizeBytes; }
+
+    private:
+        void *m_data = nullptr;
+        uint64_t m_sizeBytes = 0;
+#ifdef _WIN32
+        HANDLE m_file = INVALID_HANDLE_VALUE;
+        HANDLE m_mapping = nullptr;
+#endif
+    };
+} // namespace raven
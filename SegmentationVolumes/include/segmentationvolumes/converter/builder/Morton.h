@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+namespace raven {
+    /**
+     * 3D Morton (Z-order) codes with 21 bits per axis, x occupies the lowest bit of every triple.
+     * https://graphics.stanford.edu/~seander/bithacks.html#InterleaveBMN
+     */
+    class Morton {
+    public:
+        static constexpr uint32_t BITS_PER_AXIS = 21;
+
+        static uint64_t encode(const uint32_t x, const uint32_t y, const uint32_t z) {
+            return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+        }
+
+        // number of key bits needed for coordinates in [0, maxCoordinate]
+        static uint32_t keyBits(const uint32_t maxCoordinate) {
+            uint32_t bits = 0;
+            while (bits < BITS_PER_AXIS && (maxCoordinate >> bits) != 0) {
+                bits++;
+            }
+            return 3 * bits;
+        }
+
+    private:
+        static uint64_t spread(const uint32_t v) {
+            uint64_t x = v & 0x1FFFFF;
+            x = (x | (x << 32)) & 0x1F00000000FFFFull;
+            x = (x | (x << 16)) & 0x1F0000FF0000FFull;
+            x = (x | (x << 8)) & 0x100F00F00F00F00Full;
+            x = (x | (x << 4)) & 0x10C30C30C30C30C3ull;
+            x = (x | (x << 2)) & 0x1249249249249249ull;
+            return x;
+        }
+    };
+} // namespace raven
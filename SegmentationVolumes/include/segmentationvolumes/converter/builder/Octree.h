@@ -4,7 +4,20 @@
 #include "raven/util/AABB.h"
 
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <exception>
+#include <span>
 #include <stdexcept>
+#include <vector>
+
+#include <omp.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 namespace raven {
     /**
@@ -16,17 +29,91 @@ namespace raven {
     public:
         typedef glm::ivec3 Voxel;
 
+        enum Builder {
+            BUILDER_PARTITION, // recursive std::partition of the voxels, see buildCellOctree
+            BUILDER_BITMASK,   // rasterize the voxels into a 16^3 bitmask and classify the cells with word-wide reductions, see buildBitmaskOctree
+        };
+
+        explicit Octree(const Builder builder = BUILDER_PARTITION) : m_builder(builder) {}
+
+        /**
+         * 16^3 occupancy bitmask, bit i is the voxel with the local Morton code i (x in the lowest bit of every triple, as the child index of OctreeNode).
+         * Every octree cell of extent e is then a contiguous, aligned range of e^3 bits: 64 words (16^3), 8 words (8^3), 1 word (4^3), 1 byte (2^3), 1 bit (1^3).
+         */
+        struct alignas(32) BrickMask {
+            std::array<uint64_t, 64> words;
+        };
+
+        // bit of the voxel at local coordinates [0, 16)^3 in the BrickMask
+        static uint32_t brickMaskBit(const glm::ivec3 local) {
+            return MORTON_SPREAD_4[local.x] | (MORTON_SPREAD_4[local.y] << 1) | (MORTON_SPREAD_4[local.z] << 2);
+        }
+
+        // local coordinates of a bit of the BrickMask
+        static glm::ivec3 brickMaskVoxel(const uint32_t bit) {
+            const auto compact = [](const uint32_t v) { return static_cast<int32_t>((v & 1) | ((v >> 2) & 2) | ((v >> 4) & 4) | ((v >> 6) & 8)); };
+            return {compact(bit), compact(bit >> 1), compact(bit >> 2)};
+        }
+
         struct OctreeBuildInfo {
             uint32_t labelId;
             iAABB aabb;
-            std::vector<Voxel> voxels;
+            glm::ivec3 anchor; // minimum corner of the 16^3 octree, aabb.m_min unless the octree is aligned to a lattice
+            std::span<Voxel> voxels; // view into the voxel buffer of the label, reordered in place during construction
+            const BrickMask *mask = nullptr; // occupancy of [anchor, anchor + 16), if set the octree is built from the mask with the bitmask builder and voxels is ignored
         };
 
+        /**
+         * The octrees are built in parallel, every thread appends its octrees to its own node arena.
+         * A prefix sum over the octree sizes in input order then yields m_octreeIndices and the arenas are copied in parallel into m_octrees,
+         * hence the result is identical to building the octrees one after another.
+         */
         void buildOctrees(std::vector<OctreeBuildInfo> &octreeBuildInfos) {
-            m_octreeIndices.resize(octreeBuildInfos.size());
+            const auto numOctrees = static_cast<int64_t>(octreeBuildInfos.size());
+            m_octreeIndices.resize(numOctrees);
+
+            std::vector<std::vector<OctreeNode>> arenas(omp_get_max_threads());
+            std::vector<uint32_t> octreeArena(numOctrees);
+            std::vector<uint64_t> octreeOffset(numOctrees); // offset in the arena
+            std::vector<uint32_t> octreeSize(numOctrees);
+            std::exception_ptr exception;
+
+#pragma omp parallel if (numOctrees >= PARALLEL_MIN_OCTREES)
+            {
+                const auto arena = static_cast<uint32_t>(omp_get_thread_num());
+                std::vector<OctreeNode> scratch;
+#pragma omp for schedule(dynamic, 64)
+                for (int64_t i = 0; i < numOctrees; i++) {
+                    try {
+                        octreeArena[i] = arena;
+                        octreeOffset[i] = arenas[arena].size();
+                        buildOctree(octreeBuildInfos[i], scratch, arenas[arena]);
+                        octreeSize[i] = static_cast<uint32_t>(arenas[arena].size() - octreeOffset[i]);
+                    } catch (...) {
+#pragma omp critical
+                        if (!exception) {
+                            exception = std::current_exception();
+                        }
+                    }
+                }
+            }
+            if (exception) {
+                std::rethrow_exception(exception);
+            }
+
+            uint64_t numNodes = m_octrees.size();
+            for (int64_t i = 0; i < numOctrees; i++) {
+                if (numNodes > UINT32_MAX) {
+                    throw std::runtime_error("OctreeBuilding: Octree index exceeds 32 bits.");
+                }
+                m_octreeIndices[i] = static_cast<uint32_t>(numNodes);
+                numNodes += octreeSize[i];
+            }
+            m_octrees.resize(numNodes);
 
-            for (uint32_t i = 0; i < octreeBuildInfos.size(); i++) {
-                buildOctree(octreeBuildInfos[i], i);
+#pragma omp parallel for schedule(static) if (numOctrees >= PARALLEL_MIN_OCTREES)
+            for (int64_t i = 0; i < numOctrees; i++) {
+                std::copy_n(arenas[octreeArena[i]].begin() + static_cast<int64_t>(octreeOffset[i]), octreeSize[i], m_octrees.begin() + m_octreeIndices[i]);
             }
         }
 
@@ -56,22 +143,124 @@ namespace raven {
         std::vector<OctreeNode> m_octrees = {}; // GPU buffer
         std::vector<uint32_t> m_octreeIndices = {};
 
+        static constexpr uint32_t BRICK_MAX_NODES = 1 + 8 + 64 + 512 + 4096;
+
+        // builds the octree of the voxels in [anchor, anchor + 16) into outNodes, same encoding and node order as buildCellOctree, returns the number of nodes
+        static uint32_t buildBitmaskOctree(const std::span<const Voxel> voxels, const glm::ivec3 anchor, std::array<OctreeNode, BRICK_MAX_NODES> &outNodes) {
+            if (voxels.size() == 16 * 16 * 16) { // as buildCellOctree, the voxels are expected to be unique
+                outNodes[0] = static_cast<OctreeNode>(4 << OCTREE_NODE_EXTENT_SHIFT) | OCTREE_NODE_SOLID_BITS | OCTREE_NODE_INVALID_CHILD;
+                return 1;
+            }
+
+            BrickMask mask{};
+            for (const auto &voxel: voxels) {
+                const glm::ivec3 local = voxel - anchor;
+                if (((local.x | local.y | local.z) & ~15) != 0) {
+                    throw std::runtime_error("OctreeBitmaskBuilding: Voxel outside of the 16^3 octree.");
+                }
+                const uint32_t bit = brickMaskBit(local);
+                mask.words[bit >> 6] |= UINT64_C(1) << (bit & 63);
+            }
+            return buildBitmaskOctree(mask, outNodes);
+        }
+
+        static uint32_t buildBitmaskOctree(const BrickMask &mask, std::array<OctreeNode, BRICK_MAX_NODES> &outNodes) {
+            uint32_t numNodes = 1;
+            buildBitmaskCell(mask, outNodes, 0, 0, 4, numNodes);
+            return numNodes;
+        }
+
     private:
-        void buildOctree(OctreeBuildInfo &octreeBuildInfo, const uint32_t octreeBuildInfoIndex) {
-            std::vector<OctreeNode> octree;
+        static constexpr int64_t PARALLEL_MIN_OCTREES = 256;
+
+        Builder m_builder;
+
+        // 4 bit coordinate -> bits at positions 0, 3, 6, 9 (Morton::encode restricted to 16^3)
+        static constexpr std::array<uint32_t, 16> MORTON_SPREAD_4 = {0x000, 0x001, 0x008, 0x009, 0x040, 0x041, 0x048, 0x049, 0x200, 0x201, 0x208, 0x209, 0x240, 0x241, 0x248, 0x249};
+
+        enum CellState {
+            CELL_EMPTY,
+            CELL_SOLID,
+            CELL_MIXED,
+        };
+
+        // classifies the 8^(extentExponent) bits of the cell that starts at bit firstBit
+        static CellState bitmaskCellState(const BrickMask &mask, const uint32_t firstBit, const uint32_t extentExponent) {
+            if (extentExponent >= 2) {
+                const uint64_t *words = mask.words.data() + (firstBit >> 6);
+                const uint32_t numWords = 1u << (3 * extentExponent - 6);
+#ifdef __AVX2__
+                if (numWords >= 4) {
+                    const __m256i ones = _mm256_set1_epi64x(-1);
+                    __m256i orBits = _mm256_setzero_si256();
+                    __m256i andBits = ones;
+                    for (uint32_t i = 0; i < numWords; i += 4) {
+                        const __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i *>(words + i));
+                        orBits = _mm256_or_si256(orBits, v);
+                        andBits = _mm256_and_si256(andBits, v);
+                    }
+                    if (_mm256_testz_si256(orBits, orBits)) {
+                        return CELL_EMPTY;
+                    }
+                    return _mm256_testc_si256(andBits, ones) ? CELL_SOLID : CELL_MIXED;
+                }
+#endif
+                uint64_t orBits = 0;
+                uint64_t andBits = ~UINT64_C(0);
+                for (uint32_t i = 0; i < numWords; i++) {
+                    orBits |= words[i];
+                    andBits &= words[i];
+                }
+                return orBits == 0 ? CELL_EMPTY : (andBits == ~UINT64_C(0) ? CELL_SOLID : CELL_MIXED);
+            }
+            const uint32_t numBits = 1u << (3 * extentExponent);
+            const uint64_t bits = (mask.words[firstBit >> 6] >> (firstBit & 63)) & ((UINT64_C(1) << numBits) - 1);
+            return bits == 0 ? CELL_EMPTY : (std::popcount(bits) == static_cast<int>(numBits) ? CELL_SOLID : CELL_MIXED);
+        }
+
+        static void buildBitmaskCell(const BrickMask &mask, std::array<OctreeNode, BRICK_MAX_NODES> &nodes, const uint32_t nodeIdx, const uint32_t firstBit, const uint32_t extentExponent, uint32_t &numNodes) {
+            const CellState state = bitmaskCellState(mask, firstBit, extentExponent);
+            const auto extentBits = static_cast<OctreeNode>(extentExponent << OCTREE_NODE_EXTENT_SHIFT);
+            if (state != CELL_MIXED) {
+                nodes[nodeIdx] = extentBits | (state == CELL_SOLID ? OCTREE_NODE_SOLID_BITS : 0) | OCTREE_NODE_INVALID_CHILD;
+                return;
+            }
+
+            const uint32_t child = numNodes;
+            if (child >= OCTREE_NODE_INVALID_CHILD) { // ensure that the child pointer uses 12 bits only
+                throw std::runtime_error("OctreeBitmaskBuilding: Invalid child pointer.");
+            }
+            numNodes += 8;
+            nodes[nodeIdx] = extentBits | static_cast<OctreeNode>(child);
+            const uint32_t childBits = 1u << (3 * (extentExponent - 1));
+            for (uint32_t i = 0; i < 8; i++) {
+                buildBitmaskCell(mask, nodes, child + i, firstBit + i * childBits, extentExponent - 1, numNodes);
+            }
+        }
+
+        // appends the octree to the arena, scratch is reused between the octrees of a thread
+        void buildOctree(OctreeBuildInfo &octreeBuildInfo, std::vector<OctreeNode> &scratch, std::vector<OctreeNode> &arena) const {
+            if (m_builder == BUILDER_BITMASK || octreeBuildInfo.mask != nullptr) {
+                std::array<OctreeNode, BRICK_MAX_NODES> octree;
+                const uint32_t numNodes = octreeBuildInfo.mask != nullptr ? buildBitmaskOctree(*octreeBuildInfo.mask, octree) : buildBitmaskOctree(octreeBuildInfo.voxels, octreeBuildInfo.anchor, octree);
+                arena.insert(arena.end(), octree.begin(), octree.begin() + numNodes);
+                return;
+            }
+
+            auto &octree = scratch;
+            octree.clear();
             octree.emplace_back();
 
             // const uint32_t maxExtent = octreeBuildInfo.aabb.maxExtent();
             // const uint32_t extent = nextPowerOfTwo(maxExtent);
             constexpr uint32_t extent = 16; // enforce 16^3, the traversal implicitly assumes that every AABB contains a 16^3 octree/DAG
 
-            buildCellOctree(octree, 0, octreeBuildInfo.aabb.m_min, extent, 0, octreeBuildInfo.voxels.size(), octreeBuildInfo.voxels);
+            buildCellOctree(octree, 0, octreeBuildInfo.anchor, extent, 0, octreeBuildInfo.voxels.size(), octreeBuildInfo.voxels);
 
-            m_octreeIndices[octreeBuildInfoIndex] = m_octrees.size();
-            m_octrees.insert(m_octrees.end(), octree.begin(), octree.end());
+            arena.insert(arena.end(), octree.begin(), octree.end());
         }
 
-        static void buildCellOctree(std::vector<OctreeNode> &octree, const uint32_t octreeNodeIdx, const glm::ivec3 anchor, const uint16_t extent, const uint32_t firstVoxelId, const uint32_t numVoxels, std::vector<Voxel> &voxels) {
+        static void buildCellOctree(std::vector<OctreeNode> &octree, const uint32_t octreeNodeIdx, const glm::ivec3 anchor, const uint16_t extent, const uint32_t firstVoxelId, const uint32_t numVoxels, std::span<Voxel> voxels) {
             if (!(extent != 0 && (extent & (extent - 1)) == 0)) { // extent is power of 2, http://www.graphics.stanford.edu/~seander/bithacks.html#DetermineIfPowerOf2
                 throw std::runtime_error("OctreeCellBuilding: Invalid extent.");
             }
@@ -155,9 +344,9 @@ namespace raven {
             buildCellOctree(octree, child + 0b111, anchor + glm::ivec3(extentHalf, extentHalf, extentHalf), extentHalf, firstVoxelId + numVoxels0 + numVoxels10 + numVoxels110, numVoxels111, voxels);
         }
 
-        static uint32_t reorderOctreeVoxels(const uint32_t firstVoxelId, const uint32_t numVoxels, std::vector<Voxel> &voxels, glm::ivec3 cellMin, uint32_t extent, int axis) {
+        static uint32_t reorderOctreeVoxels(const uint32_t firstVoxelId, const uint32_t numVoxels, std::span<Voxel> voxels, glm::ivec3 cellMin, uint32_t extent, int axis) {
             const auto middle = std::partition(voxels.begin() + firstVoxelId, voxels.begin() + firstVoxelId + numVoxels,
-                             [cellMin, extent, axis](const Voxel &voxel) -> bool { return voxel[axis] < cellMin[axis] + extent / 2; });
+                             [cellMin, extent, axis](const Voxel &voxel) -> bool { return voxel[axis] < cellMin[axis] + static_cast<int32_t>(extent / 2); }); // signed, cells may straddle 0
             return std::distance(voxels.begin() + firstVoxelId, middle);
         }
 
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Octree.h"
+#include "glm/geometric.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace raven {
+    /**
+     * Compares the octree builders (Octree::BUILDER_PARTITION and Octree::BUILDER_BITMASK) on synthetic 16^3 bricks.
+     * Both builders have to produce identical octrees.
+     */
+    class OctreeBenchmark {
+    public:
+        static void benchmark(const uint32_t numBricks = 100000, const uint32_t iterations = 3) {
+            std::mt19937 random(42);
+            std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+            const std::vector<std::pair<std::string, std::function<bool(glm::ivec3, glm::vec3, float)>>> shapes = {
+                    {"sparse", [&](glm::ivec3, glm::vec3, float) { return uniform(random) < 0.01f; }},
+                    {"noise", [&](glm::ivec3, glm::vec3, float) { return uniform(random) < 0.1f; }},
+                    {"sphere", [](const glm::ivec3 v, const glm::vec3 center, const float radius) { return glm::length(glm::vec3(v) + 0.5f - center) < radius; }},
+                    {"solid", [](glm::ivec3, glm::vec3, float) { return true; }},
+            };
+
+            for (const auto &[name, inside]: shapes) {
+                std::vector<Octree::Voxel> voxels;
+                std::vector<Octree::OctreeBuildInfo> octreeBuildInfos(numBricks);
+                std::vector<uint64_t> firstVoxel(numBricks + 1, 0);
+                for (uint32_t b = 0; b < numBricks; b++) {
+                    const glm::ivec3 anchor(static_cast<int32_t>(b % 1024) * 16, static_cast<int32_t>(b / 1024) * 16, 0);
+                    const glm::vec3 center(uniform(random) * 16.f, uniform(random) * 16.f, uniform(random) * 16.f);
+                    const float radius = 4.f + uniform(random) * 6.f;
+                    firstVoxel[b] = voxels.size();
+                    for (int32_t z = 0; z < 16; z++) {
+                        for (int32_t y = 0; y < 16; y++) {
+                            for (int32_t x = 0; x < 16; x++) {
+                                if (inside(glm::ivec3(x, y, z), center, radius)) {
+                                    voxels.push_back(anchor + glm::ivec3(x, y, z));
+                                }
+                            }
+                        }
+                    }
+                    octreeBuildInfos[b].labelId = b;
+                    octreeBuildInfos[b].anchor = anchor;
+                }
+                firstVoxel[numBricks] = voxels.size();
+
+                const std::vector<Octree::Voxel> inVoxels = voxels;
+                std::vector<Octree::OctreeNode> referenceOctrees;
+                std::vector<uint32_t> referenceOctreeIndices;
+                for (const auto &builder: {Octree::BUILDER_PARTITION, Octree::BUILDER_BITMASK}) {
+                    double minTime = std::numeric_limits<double>::max();
+                    double totalTime = 0;
+                    Octree octree(builder);
+                    for (uint32_t i = 0; i < iterations; i++) {
+                        voxels = inVoxels; // the partition builder reorders the voxels
+                        for (uint32_t b = 0; b < numBricks; b++) {
+                            octreeBuildInfos[b].voxels = std::span(voxels).subspan(firstVoxel[b], firstVoxel[b + 1] - firstVoxel[b]);
+                        }
+
+                        octree = Octree(builder);
+                        const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+                        octree.buildOctrees(octreeBuildInfos);
+                        const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+                        const double cpuTime = (static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) * std::pow(10, -3));
+                        minTime = std::min(minTime, cpuTime);
+                        totalTime += cpuTime;
+                    }
+
+                    if (builder == Octree::BUILDER_PARTITION) {
+                        referenceOctrees = octree.m_octrees;
+                        referenceOctreeIndices = octree.m_octreeIndices;
+                    } else if (octree.m_octrees != referenceOctrees || octree.m_octreeIndices != referenceOctreeIndices) {
+                        throw std::runtime_error("OctreeBenchmark: Bitmask octrees differ from partition octrees (" + name + ").");
+                    }
+
+                    std::cout << "[OctreeBenchmark] " << name << ", " << (builder == Octree::BUILDER_PARTITION ? "partition" : "bitmask") << ": " << inVoxels.size() << " voxels, "
+                              << octree.m_octrees.size() << " nodes, min " << minTime << "[ms], avg " << totalTime / iterations << "[ms]." << std::endl;
+                }
+            }
+        }
+    };
+} // namespace raven
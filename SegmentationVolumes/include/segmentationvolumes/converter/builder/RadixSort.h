@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <omp.h>
+
+namespace raven {
+    /**
+     * Parallel, stable LSD radix sort with 8 bit digits.
+     * - the input is split into one contiguous block per thread, every pass builds per thread digit histograms and scatters the blocks in order
+     * - passes in which all keys share the same digit are skipped
+     * - key(element) has to return an unsigned integer, only the lower keyBits bits are sorted
+     */
+    class RadixSort {
+    public:
+        template<typename T, typename KeyFunction>
+        static void sort(std::vector<T> &data, std::vector<T> &scratch, KeyFunction key, const uint32_t keyBits = 64) {
+            const size_t n = data.size();
+            if (n <= 1) {
+                return;
+            }
+            scratch.resize(n);
+
+            const auto numThreads = static_cast<uint32_t>(std::max(1, std::min(omp_get_max_threads(), static_cast<int>((n + MIN_BLOCK_SIZE - 1) / MIN_BLOCK_SIZE))));
+            const size_t blockSize = (n + numThreads - 1) / numThreads;
+            std::vector<size_t> histograms(static_cast<size_t>(numThreads) * RADIX);
+
+            T *src = data.data();
+            T *dst = scratch.data();
+
+            for (uint32_t shift = 0; shift < keyBits; shift += DIGIT_BITS) {
+                std::fill(histograms.begin(), histograms.end(), 0);
+
+#pragma omp parallel for num_threads(numThreads)
+                for (int32_t t = 0; t < static_cast<int32_t>(numThreads); t++) {
+                    size_t *histogram = histograms.data() + static_cast<size_t>(t) * RADIX;
+                    const size_t begin = std::min(n, static_cast<size_t>(t) * blockSize);
+                    const size_t end = std::min(n, begin + blockSize);
+                    for (size_t i = begin; i < end; i++) {
+                        histogram[digit(key(src[i]), shift)]++;
+                    }
+                }
+
+                // skip pass if all keys share the same digit
+                {
+                    const uint32_t firstDigit = digit(key(src[0]), shift);
+                    size_t count = 0;
+                    for (uint32_t t = 0; t < numThreads; t++) {
+                        count += histograms[static_cast<size_t>(t) * RADIX + firstDigit];
+                    }
+                    if (count == n) {
+                        continue;
+                    }
+                }
+
+                // exclusive prefix sum, digit major, thread minor
+                size_t offset = 0;
+                for (uint32_t d = 0; d < RADIX; d++) {
+                    for (uint32_t t = 0; t < numThreads; t++) {
+                        const size_t count = histograms[static_cast<size_t>(t) * RADIX + d];
+                        histograms[static_cast<size_t>(t) * RADIX + d] = offset;
+                        offset += count;
+                    }
+                }
+
+#pragma omp parallel for num_threads(numThreads)
+                for (int32_t t = 0; t < static_cast<int32_t>(numThreads); t++) {
+                    size_t *offsets = histograms.data() + static_cast<size_t>(t) * RADIX;
+                    const size_t begin = std::min(n, static_cast<size_t>(t) * blockSize);
+                    const size_t end = std::min(n, begin + blockSize);
+                    for (size_t i = begin; i < end; i++) {
+                        dst[offsets[digit(key(src[i]), shift)]++] = src[i];
+                    }
+                }
+
+                std::swap(src, dst);
+            }
+
+            if (src != data.data()) {
+                data.swap(scratch);
+            }
+        }
+
+    private:
+        static constexpr uint32_t DIGIT_BITS = 8;
+        static constexpr uint32_t RADIX = 1u << DIGIT_BITS;
+        static constexpr size_t MIN_BLOCK_SIZE = 1 << 16; // do not spawn threads for tiny inputs
+
+        template<typename K>
+        static uint32_t digit(const K key, const uint32_t shift) {
+            return static_cast<uint32_t>((static_cast<uint64_t>(key) >> shift) & (RADIX - 1));
+        }
+    };
+} // namespace raven
@@ -0,0 +1,402 @@
+#pragma once
+
+#include "Octree.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace raven {
+    /**
+     * Intermediate voxel format of a label: the occupied voxels are grouped into the bricks of the global 16^3 lattice.
+     * Every brick is stored as a record [ BrickHeader | payload ], the payload is either
+     * - the run-length encoded Morton order of the brick (numRuns x BrickRun, 4 bytes per run of occupied voxels) or
+     * - the 512 byte Octree::BrickMask (numRuns = 0) if this is smaller.
+     * Compared to one glm::ivec3 per voxel, solid bricks shrink from 48KiB to 24 bytes and no brick exceeds 532 bytes.
+     * Files are appended to (e.g. one volume chunk after another), a brick that occurs multiple times is merged when read.
+     * Instead of a file per label, the records of all labels can be appended to a single shard container, see appendShards.
+     */
+    class VoxelBricks {
+    public:
+        static constexpr auto EXTENSION = ".bricks";
+        static constexpr auto SHARD_EXTENSION = ".shards";
+        static constexpr auto SHARD_INDEX_EXTENSION = ".index";
+        static constexpr uint32_t BRICK_VOXELS = 16 * 16 * 16;
+
+        struct Brick {
+            glm::ivec3 coordinate; // in bricks, the brick covers [16 * coordinate, 16 * coordinate + 16)
+            uint32_t id;           // instance of the label (e.g. the cell id), 0 if the label has a single instance
+            Octree::BrickMask mask;
+        };
+
+        struct Info {
+            uint64_t numBricks = 0;
+            uint64_t numVoxels = 0;
+        };
+
+        // records of a label in a shard container
+        struct ShardExtent {
+            uint32_t label;
+            uint32_t numBricks;
+            uint64_t offset; // in bytes
+            uint64_t size;   // in bytes
+            uint64_t numVoxels;
+        };
+        static_assert(sizeof(ShardExtent) == 32);
+
+        [[nodiscard]] static bool isBrickFile(const std::filesystem::path &path) {
+            return path.extension() == EXTENSION;
+        }
+
+        [[nodiscard]] static bool isShardFile(const std::filesystem::path &path) {
+            return path.extension() == SHARD_EXTENSION;
+        }
+
+        [[nodiscard]] static bool isShardIndexFile(const std::filesystem::path &path) {
+            return path.extension() == SHARD_INDEX_EXTENSION;
+        }
+
+        [[nodiscard]] static std::filesystem::path shardIndexFile(const std::filesystem::path &path) {
+            return std::filesystem::path(path).replace_extension(SHARD_INDEX_EXTENSION);
+        }
+
+        static std::vector<Brick> build(const std::span<const glm::ivec3> voxels) {
+            return build(voxels.size(), [&voxels](const size_t i) { return voxels[i]; }, [](size_t) { return 0u; });
+        }
+
+        // the w component is the id of the voxel
+        static std::vector<Brick> build(const std::span<const glm::ivec4> voxels) {
+            return build(voxels.size(), [&voxels](const size_t i) { return glm::ivec3(voxels[i].x, voxels[i].y, voxels[i].z); }, [&voxels](const size_t i) { return static_cast<uint32_t>(voxels[i].w); });
+        }
+
+        static void append(const std::string &path, const std::vector<Brick> &bricks) {
+            std::vector<char> buffer;
+            encode(bricks, buffer);
+            std::ofstream(path, std::ios::binary | std::ios::app).write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        }
+
+        /**
+         * Appends the records of all labels to the shard container at path with a single write and then the extent of every label to its index file (shardIndexFile),
+         * i.e. the index never refers to records that have not been written. A label has one extent per call.
+         */
+        static void appendShards(const std::string &path, const std::map<uint32_t, std::vector<Brick>> &labels) {
+            const uint64_t offset = std::filesystem::exists(path) ? std::filesystem::file_size(path) : 0;
+            std::vector<char> buffer;
+            std::vector<ShardExtent> extents;
+            for (const auto &[label, bricks]: labels) {
+                if (bricks.empty()) {
+                    continue;
+                }
+                const uint64_t begin = buffer.size();
+                const uint64_t numVoxels = encode(bricks, buffer);
+                extents.push_back({.label = label, .numBricks = static_cast<uint32_t>(bricks.size()), .offset = offset + begin, .size = buffer.size() - begin, .numVoxels = numVoxels});
+            }
+            std::ofstream out(path, std::ios::binary | std::ios::app);
+            out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            out.close();
+            if (!out) {
+                throw std::runtime_error("VoxelBricks: Failed to write " + path + ".");
+            }
+            std::ofstream(shardIndexFile(path), std::ios::binary | std::ios::app).write(reinterpret_cast<const char *>(extents.data()), static_cast<std::streamsize>(extents.size() * sizeof(ShardExtent)));
+        }
+
+        // extents of every label of the shard container at path, in the order they were appended
+        static std::map<uint32_t, std::vector<ShardExtent>> shardIndex(const std::string &path) {
+            const std::filesystem::path indexPath = shardIndexFile(path);
+            const uint64_t size = std::filesystem::file_size(indexPath);
+            if (size % sizeof(ShardExtent) != 0) {
+                throw std::runtime_error("VoxelBricks: Truncated file " + indexPath.string() + ".");
+            }
+            std::vector<ShardExtent> extents(size / sizeof(ShardExtent));
+            std::ifstream(indexPath, std::ios::binary).read(reinterpret_cast<char *>(extents.data()), static_cast<std::streamsize>(size));
+
+            std::map<uint32_t, std::vector<ShardExtent>> index;
+            for (const auto &extent: extents) {
+                index[extent.label].push_back(extent);
+            }
+            return index;
+        }
+
+        // reads the bricks sorted by (id, z, y, x), bricks that occur multiple times are merged
+        static void read(const std::string &path, std::vector<Brick> &outBricks) {
+            std::vector<char> raw(std::filesystem::file_size(path));
+            std::ifstream(path, std::ios::binary).read(raw.data(), static_cast<std::streamsize>(raw.size()));
+            decode(raw, path, outBricks);
+        }
+
+        // reads the bricks of the extents of a label from the shard container at path, see read
+        static void read(const std::string &path, const std::vector<ShardExtent> &extents, std::vector<Brick> &outBricks) {
+            uint64_t size = 0;
+            for (const auto &extent: extents) {
+                size += extent.size;
+            }
+            std::vector<char> raw(size);
+            std::ifstream in(path, std::ios::binary);
+            uint64_t offset = 0;
+            for (const auto &extent: extents) {
+                in.seekg(static_cast<std::streamoff>(extent.offset));
+                in.read(raw.data() + offset, static_cast<std::streamsize>(extent.size));
+                offset += extent.size;
+            }
+            if (!in) {
+                throw std::runtime_error("VoxelBricks: Truncated file " + path + ".");
+            }
+            decode(raw, path, outBricks);
+        }
+
+        // number of records and voxels from the headers only, bricks that occur multiple times are counted multiple times
+        static Info info(const std::string &path) {
+            Info info;
+            std::ifstream in(path, std::ios::binary);
+            const uint64_t size = std::filesystem::file_size(path);
+            uint64_t offset = 0;
+            while (offset < size) {
+                BrickHeader header{};
+                in.seekg(static_cast<std::streamoff>(offset));
+                in.read(reinterpret_cast<char *>(&header), sizeof(BrickHeader));
+                if (!in) {
+                    throw std::runtime_error("VoxelBricks: Truncated file " + path + ".");
+                }
+                info.numBricks++;
+                info.numVoxels += header.numVoxels;
+                offset += sizeof(BrickHeader) + payloadSize(header);
+            }
+            return info;
+        }
+
+        // number of records and voxels of the extents of a label in a shard container
+        static Info info(const std::vector<ShardExtent> &extents) {
+            Info info;
+            for (const auto &extent: extents) {
+                info.numBricks += extent.numBricks;
+                info.numVoxels += extent.numVoxels;
+            }
+            return info;
+        }
+
+        // appends the voxels of the brick in Morton order
+        static void expand(const Brick &brick, std::vector<glm::ivec3> &outVoxels) {
+            const glm::ivec3 anchor = brick.coordinate * 16;
+            for (uint32_t w = 0; w < 64; w++) {
+                for (uint64_t word = brick.mask.words[w]; word != 0; word &= word - 1) {
+                    outVoxels.push_back(anchor + Octree::brickMaskVoxel(w * 64 + std::countr_zero(word)));
+                }
+            }
+        }
+
+        // tight bounds of the occupied voxels in world coordinates, empty if the brick is empty
+        static iAABB bounds(const Brick &brick) {
+            iAABB aabb{};
+            const glm::ivec3 anchor = brick.coordinate * 16;
+            for (uint32_t w = 0; w < 64; w++) {
+                for (uint64_t word = brick.mask.words[w]; word != 0; word &= word - 1) {
+                    const glm::ivec3 voxel = anchor + Octree::brickMaskVoxel(w * 64 + std::countr_zero(word));
+                    aabb.expand(voxel);
+                    aabb.expand(voxel + glm::ivec3(1, 1, 1));
+                }
+            }
+            return aabb;
+        }
+
+        static uint32_t countVoxels(const Octree::BrickMask &mask) {
+            uint32_t count = 0;
+            for (const uint64_t word: mask.words) {
+                count += std::popcount(word);
+            }
+            return count;
+        }
+
+    private:
+#pragma pack(push, 1)
+        struct BrickHeader {
+            int32_t x, y, z;
+            uint32_t id;
+            uint16_t numVoxels;
+            uint16_t numRuns; // 0: the payload is the BrickMask
+        };
+        struct BrickRun {
+            uint16_t first; // first bit of the run in the BrickMask
+            uint16_t count;
+        };
+#pragma pack(pop)
+        static_assert(sizeof(BrickHeader) == 20 && sizeof(BrickRun) == 4);
+
+        struct BrickKey {
+            glm::ivec3 coordinate;
+            uint32_t id;
+
+            bool operator==(const BrickKey &other) const { return coordinate == other.coordinate && id == other.id; }
+        };
+
+        struct BrickKeyHash {
+            size_t operator()(const BrickKey &key) const {
+                size_t seed = std::hash<uint32_t>()(key.id);
+                for (int i = 0; i < 3; i++) {
+                    seed ^= std::hash<int32_t>()(key.coordinate[i]) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+                }
+                return seed;
+            }
+        };
+
+        template<typename Position, typename Id>
+        static std::vector<Brick> build(const size_t numVoxels, Position position, Id id) {
+            std::vector<Brick> bricks;
+            std::unordered_map<BrickKey, uint64_t, BrickKeyHash> brickIndex;
+            for (size_t i = 0; i < numVoxels; i++) {
+                const glm::ivec3 voxel = position(i);
+                const glm::ivec3 coordinate = voxel >> 4; // arithmetic shift, rounds towards -inf
+                const auto [it, inserted] = brickIndex.try_emplace({coordinate, id(i)}, bricks.size());
+                if (inserted) {
+                    bricks.push_back({.coordinate = coordinate, .id = id(i), .mask = {}});
+                }
+                const uint32_t bit = Octree::brickMaskBit(voxel - coordinate * 16);
+                bricks[it->second].mask.words[bit >> 6] |= UINT64_C(1) << (bit & 63);
+            }
+            std::sort(bricks.begin(), bricks.end(), less);
+            return bricks;
+        }
+
+        static bool less(const Brick &a, const Brick &b) {
+            if (a.id != b.id) {
+                return a.id < b.id;
+            }
+            if (a.coordinate.z != b.coordinate.z) {
+                return a.coordinate.z < b.coordinate.z;
+            }
+            if (a.coordinate.y != b.coordinate.y) {
+                return a.coordinate.y < b.coordinate.y;
+            }
+            return a.coordinate.x < b.coordinate.x;
+        }
+
+        // appends the records of the bricks to the buffer, returns the number of voxels
+        static uint64_t encode(const std::vector<Brick> &bricks, std::vector<char> &buffer) {
+            uint64_t numVoxels = 0;
+            std::vector<BrickRun> runs;
+            for (const auto &brick: bricks) {
+                const bool sparse = encodeRuns(brick.mask, runs);
+                const BrickHeader header{brick.coordinate.x, brick.coordinate.y, brick.coordinate.z, brick.id, static_cast<uint16_t>(countVoxels(brick.mask)), static_cast<uint16_t>(sparse ? runs.size() : 0)};
+                appendBytes(buffer, &header, sizeof(BrickHeader));
+                if (header.numRuns != 0) {
+                    appendBytes(buffer, runs.data(), runs.size() * sizeof(BrickRun));
+                } else {
+                    appendBytes(buffer, brick.mask.words.data(), sizeof(Octree::BrickMask));
+                }
+                numVoxels += header.numVoxels;
+            }
+            return numVoxels;
+        }
+
+        // decodes the records, the bricks are sorted by (id, z, y, x) and bricks that occur multiple times are merged
+        static void decode(const std::vector<char> &raw, const std::string &path, std::vector<Brick> &outBricks) {
+            outBricks.clear();
+            forEachRecord(raw, path, [&outBricks, &path](const BrickHeader &header, const char *payload) {
+                Brick &brick = outBricks.emplace_back();
+                brick.coordinate = glm::ivec3(header.x, header.y, header.z);
+                brick.id = header.id;
+                if (header.numRuns == 0) {
+                    std::memcpy(brick.mask.words.data(), payload, sizeof(Octree::BrickMask));
+                } else {
+                    brick.mask = {};
+                    for (uint32_t r = 0; r < header.numRuns; r++) {
+                        BrickRun run;
+                        std::memcpy(&run, payload + r * sizeof(BrickRun), sizeof(BrickRun));
+                        if (run.first + run.count > BRICK_VOXELS) {
+                            throw std::runtime_error("VoxelBricks: Invalid run in " + path + ".");
+                        }
+                        setRange(brick.mask, run.first, run.first + run.count);
+                    }
+                }
+            });
+
+            if (std::adjacent_find(outBricks.begin(), outBricks.end(), [](const Brick &a, const Brick &b) { return !less(a, b); }) == outBricks.end()) {
+                return; // strictly increasing, i.e. written by a single append
+            }
+            std::sort(outBricks.begin(), outBricks.end(), less);
+            uint64_t numUnique = 0;
+            for (uint64_t i = 0; i < outBricks.size(); i++) {
+                if (numUnique > 0 && !less(outBricks[numUnique - 1], outBricks[i])) {
+                    for (uint32_t w = 0; w < 64; w++) {
+                        outBricks[numUnique - 1].mask.words[w] |= outBricks[i].mask.words[w];
+                    }
+                } else {
+                    outBricks[numUnique++] = outBricks[i];
+                }
+            }
+            outBricks.resize(numUnique);
+        }
+
+        static uint64_t payloadSize(const BrickHeader &header) {
+            return header.numRuns == 0 ? sizeof(Octree::BrickMask) : header.numRuns * sizeof(BrickRun);
+        }
+
+        template<typename Callback>
+        static void forEachRecord(const std::vector<char> &raw, const std::string &path, Callback callback) {
+            uint64_t offset = 0;
+            while (offset < raw.size()) {
+                BrickHeader header;
+                if (offset + sizeof(BrickHeader) > raw.size()) {
+                    throw std::runtime_error("VoxelBricks: Truncated file " + path + ".");
+                }
+                std::memcpy(&header, raw.data() + offset, sizeof(BrickHeader));
+                offset += sizeof(BrickHeader);
+                if (offset + payloadSize(header) > raw.size()) {
+                    throw std::runtime_error("VoxelBricks: Truncated file " + path + ".");
+                }
+                callback(header, raw.data() + offset);
+                offset += payloadSize(header);
+            }
+        }
+
+        // first bit >= bit that is set (or unset), BRICK_VOXELS if there is none
+        static uint32_t nextBit(const Octree::BrickMask &mask, uint32_t bit, const bool set) {
+            while (bit < BRICK_VOXELS) {
+                const uint64_t word = (set ? mask.words[bit >> 6] : ~mask.words[bit >> 6]) >> (bit & 63);
+                if (word != 0) {
+                    return bit + std::countr_zero(word);
+                }
+                bit = (bit | 63) + 1;
+            }
+            return BRICK_VOXELS;
+        }
+
+        // false if the runs are not smaller than the mask, an empty brick has no runs and is stored as mask
+        static bool encodeRuns(const Octree::BrickMask &mask, std::vector<BrickRun> &outRuns) {
+            outRuns.clear();
+            for (uint32_t bit = nextBit(mask, 0, true); bit < BRICK_VOXELS; bit = nextBit(mask, bit, true)) {
+                if ((outRuns.size() + 1) * sizeof(BrickRun) >= sizeof(Octree::BrickMask)) {
+                    return false;
+                }
+                const uint32_t end = nextBit(mask, bit, false);
+                outRuns.push_back({static_cast<uint16_t>(bit), static_cast<uint16_t>(end - bit)});
+                bit = end;
+            }
+            return !outRuns.empty();
+        }
+
+        // sets the bits [first, end)
+        static void setRange(Octree::BrickMask &mask, uint32_t first, const uint32_t end) {
+            while (first < end) {
+                const uint32_t last = std::min(end, (first | 63) + 1);
+                const uint32_t count = last - first;
+                mask.words[first >> 6] |= (count == 64 ? ~UINT64_C(0) : ((UINT64_C(1) << count) - 1)) << (first & 63);
+                first = last;
+            }
+        }
+
+        static void appendBytes(std::vector<char> &buffer, const void *data, const size_t size) {
+            const auto *bytes = static_cast<const char *>(data);
+            buffer.insert(buffer.end(), bytes, bytes + size);
+        }
+    };
+} // namespace raven
@@ -53,7 +53,8 @@ namespace raven {
 
         std::vector<std::shared_ptr<Volume>> m_volumes;
 
-        uint32_t m_instanceCount = 0;
+        uint32_t m_instanceCount = 0;          // TLAS instances, i.e. segments with AABBs of all volumes, not volumes (g_num_instances)
+        std::vector<uint32_t> m_instanceVolumes; // volume of every instance, indexed by the instance custom index (the object descriptor)
 
         void load(GPUContext *gpuContext, const std::string &dataPath, const std::string &sceneName, SceneSettings *sceneSettings) {
             std::string scenePath = Paths::m_resourceDirectoryPath + "/scenes/" + sceneName + ".xml";
@@ -488,6 +489,7 @@ namespace raven {
             uint64_t blasBuffersSize = getBLASBuffersSize();
             uint64_t lodBuffersSize = getLODBuffersSize();
             uint64_t tlasBufferSize = getTLASBufferSize();
+            std::cout << "Volumes: " << m_volumes.size() << ", instances (segments): " << m_instanceCount << std::endl;
             std::cout << "AABB buffers: " << aabbBuffersSize << " bytes (" << static_cast<float>(aabbBuffersSize) * glm::pow(10, -6) << " MB)" << std::endl;
             std::cout << "LOD buffers: " << lodBuffersSize << " bytes (" << static_cast<float>(lodBuffersSize) * glm::pow(10, -6) << " MB)" << std::endl;
             std::cout << "BLAS buffers: " << blasBuffersSize << " bytes (" << static_cast<float>(blasBuffersSize) * glm::pow(10, -6) << " MB)" << std::endl;
@@ -705,11 +707,13 @@ namespace raven {
                 m_tlas = std::make_shared<TLAS>(gpuContext);
 
                 m_instanceCount = 0;
-                for (const auto &volume: m_volumes) {
-                    volume->buildBLAS(gpuContext);
+                m_instanceVolumes.clear();
+                for (uint32_t v = 0; v < m_volumes.size(); v++) {
+                    m_volumes[v]->buildBLAS(gpuContext);
 
-                    if (auto blasHandle = volume->createBLASHandle(m_instanceCount); blasHandle.has_value()) {
-                        m_tlas->addBLAS(blasHandle.value());
+                    for (const auto &blasHandle: m_volumes[v]->createBLASHandles(m_instanceCount)) {
+                        m_tlas->addBLAS(blasHandle);
+                        m_instanceVolumes.push_back(v);
                     }
                 }
 
@@ -727,9 +731,17 @@ namespace raven {
                 }
 
                 std::vector<ObjectDescriptor> objectDescriptors;
-                for (const auto &volume: m_volumes) {
-                    if (auto objectDescriptor = volume->createObjectDescriptor(); objectDescriptor.has_value()) {
-                        objectDescriptors.push_back(objectDescriptor.value());
+                for (uint32_t v = 0; v < m_volumes.size(); v++) {
+                    const auto volumeObjectDescriptors = m_volumes[v]->createObjectDescriptors(v);
+                    objectDescriptors.insert(objectDescriptors.end(), volumeObjectDescriptors.begin(), volumeObjectDescriptors.end());
+                }
+                // the instance custom index of a segment selects its object descriptor
+                if (objectDescriptors.size() != m_instanceCount) {
+                    throw std::runtime_error("Object descriptors do not match the TLAS instances.");
+                }
+                for (uint32_t i = 0; i < m_instanceCount; i++) {
+                    if (objectDescriptors[i].volumeId != m_instanceVolumes[i]) {
+                        throw std::runtime_error("Object descriptor " + std::to_string(i) + " does not belong to the volume of its instance.");
                     }
                 }
 
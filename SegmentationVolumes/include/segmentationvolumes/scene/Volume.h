@@ -69,6 +69,8 @@ namespace raven {
                 }
 
                 volumeObject = std::make_shared<Volume>(dataPath, info.attribute("folder").as_string(), name, translateVec, scaleVec, volumeType);
+                // octrees of the grid aligned subdivision (svo_grid, svdag_grid*) are anchored at the global 16^3 lattice instead of the minimum of their AABB
+                volumeObject->m_gridAligned = info.attribute("grid").as_bool(false);
             }
 
             // load AABBs + LODs
@@ -121,9 +123,11 @@ namespace raven {
         }
 
         void release() const {
-            RAVEN_BUFFER_RELEASE(m_aabbBuffer);
-            RAVEN_AS_RELEASE(m_blas);
-            RAVEN_BUFFER_RELEASE(m_lodBuffer);
+            for (const auto &segment: m_segments) {
+                RAVEN_BUFFER_RELEASE(segment.m_aabbBuffer);
+                RAVEN_AS_RELEASE(segment.m_blas);
+                RAVEN_BUFFER_RELEASE(segment.m_lodBuffer);
+            }
         }
 
         void enableAllAABBs() {
@@ -144,50 +148,64 @@ namespace raven {
                 aabb->loadData();
             }
 
-            // lod
-            if (!m_lods.empty()) {
-                uint64_t lodSize = 0;
-                for (const auto &[key, lod]: m_lods) {
-                    lod->setLODOffset(lodSize);
-                    lodSize += lod->loadDataSize();
+            // lod, the LODs are packed into segments of whole LODs with at most getMaxSegmentLODs() nodes
+            std::vector<uint64_t> segmentSizes;
+            for (const auto &[key, lod]: m_lods) {
+                const uint64_t size = lod->loadDataSize();
+                if (size / lod->getSizeofLOD() > lod->getMaxSegmentLODs()) {
+                    throw std::runtime_error(m_name + ": LOD " + lod->getName() + " too large for its pointers.");
                 }
+                if (segmentSizes.empty() || (segmentSizes.back() + size) / lod->getSizeofLOD() > lod->getMaxSegmentLODs()) {
+                    segmentSizes.push_back(0);
+                }
+                lod->setSegment(static_cast<uint32_t>(segmentSizes.size() - 1));
+                lod->setLODOffset(segmentSizes.back());
+                segmentSizes.back() += size;
+            }
 
-                std::vector<char> lodRaw(lodSize);
+            m_segments.clear();
+            m_segments.resize(std::max<size_t>(1, segmentSizes.size())); // AABBs without LOD are in the first segment
+            for (uint32_t s = 0; s < segmentSizes.size(); s++) {
+                std::vector<char> lodRaw(segmentSizes[s]);
                 for (const auto &[key, lod]: m_lods) {
-                    lod->loadData(lodRaw);
+                    if (lod->getSegment() == s) {
+                        lod->loadData(lodRaw);
+                    }
                 }
 
                 // LOD buffer
-                const std::string bufferName = "LODBuffer[" + m_name + "]";
-                const auto settings = Buffer::BufferSettings{.m_sizeBytes = lodSize,
+                const std::string bufferName = "LODBuffer[" + segmentName(s) + "]";
+                const auto settings = Buffer::BufferSettings{.m_sizeBytes = segmentSizes[s],
                                                              .m_bufferUsages = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress,
                                                              .m_memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal,
                                                              .m_memoryAllocateFlagBits = vk::MemoryAllocateFlagBits::eDeviceAddress,
                                                              .m_name = bufferName};
-                m_lodBuffer = Buffer::fillDeviceWithStagingBuffer(gpuContext, settings, lodRaw.data());
-                m_lodBufferAddress = m_lodBuffer->getDeviceAddress();
-                // m_lodBufferSize = lodSize;
+                m_segments[s].m_lodBuffer = Buffer::fillDeviceWithStagingBuffer(gpuContext, settings, lodRaw.data());
+                m_segments[s].m_lodBufferAddress = m_segments[s].m_lodBuffer->getDeviceAddress();
+            }
+            if (m_segments.size() > 1) {
+                std::cout << m_name << ": LODs split into " << m_segments.size() << " segments." << std::endl;
             }
         }
 
         void buildBLAS(GPUContext *gpuContext) {
-            RAVEN_BUFFER_RELEASE(m_aabbBuffer);
-            m_aabbBuffer = nullptr;
-            RAVEN_AS_RELEASE(m_blas);
-            m_blas = nullptr;
+            for (auto &segment: m_segments) {
+                RAVEN_BUFFER_RELEASE(segment.m_aabbBuffer);
+                segment.m_aabbBuffer = nullptr;
+                RAVEN_AS_RELEASE(segment.m_blas);
+                segment.m_blas = nullptr;
+            }
 
-            std::vector<VoxelAABB> aabbs;
-            std::vector<vk::AabbPositionsKHR> blasAABBs;
+            std::vector<std::vector<VoxelAABB>> aabbs(m_segments.size());
+            std::vector<std::vector<vk::AabbPositionsKHR>> blasAABBs(m_segments.size());
             for (const auto &aabb: m_aabbs) {
-                uint32_t lodOffset = 0;
+                uint32_t segment = 0;
+                const VolumeLOD *lod = nullptr;
                 if (m_lods.contains(aabb->getLodKey())) {
-                    const uint64_t res = m_lods[aabb->getLodKey()]->getLODOffset() / m_lods[aabb->getLodKey()]->getSizeofLOD();
-                    if (res > 0xFFFFFFFF) {
-                        throw std::runtime_error("LOD offset too large for 32bit pointer.");
-                    }
-                    lodOffset = static_cast<uint32_t>(res);
+                    lod = m_lods[aabb->getLodKey()].get();
+                    segment = lod->getSegment();
                 }
-                aabb->recordAABBs(aabbs, blasAABBs, lodOffset);
+                aabb->recordAABBs(aabbs[segment], blasAABBs[segment], lod);
             }
 
             // iAABB tempAABB{};
@@ -204,63 +222,72 @@ namespace raven {
             // std::cout << "Volume " << m_name << " AABB volume (4 bytes per label): " << xExtent * yExtent * zExtent * 4 << std::endl;
             // std::cout << "Volume " << m_name << " AABB volume (4 bytes per label) [MB]: " << static_cast<float>(xExtent * yExtent * zExtent * 4) * glm::pow(10, -6) << std::endl;
 
-            if (aabbs.empty() || blasAABBs.empty()) {
-                return;
-            }
+            for (uint32_t s = 0; s < m_segments.size(); s++) {
+                auto &segment = m_segments[s];
+                if (aabbs[s].empty() || blasAABBs[s].empty()) {
+                    continue;
+                }
 
-            {
-                // AABB buffer
-                const std::string bufferName = "AABBBuffer[" + m_name + "]";
-                const auto settings = Buffer::BufferSettings{.m_sizeBytes = static_cast<uint32_t>(aabbs.size() * sizeof(VoxelAABB)),
-                                                             .m_bufferUsages = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress,
-                                                             .m_memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal,
-                                                             .m_memoryAllocateFlagBits = vk::MemoryAllocateFlagBits::eDeviceAddress,
-                                                             .m_name = bufferName};
-                m_aabbBuffer = Buffer::fillDeviceWithStagingBuffer(gpuContext, settings, aabbs.data());
-            }
+                {
+                    // AABB buffer
+                    const std::string bufferName = "AABBBuffer[" + segmentName(s) + "]";
+                    const auto settings = Buffer::BufferSettings{.m_sizeBytes = aabbs[s].size() * sizeof(VoxelAABB),
+                                                                 .m_bufferUsages = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+                                                                 .m_memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal,
+                                                                 .m_memoryAllocateFlagBits = vk::MemoryAllocateFlagBits::eDeviceAddress,
+                                                                 .m_name = bufferName};
+                    segment.m_aabbBuffer = Buffer::fillDeviceWithStagingBuffer(gpuContext, settings, aabbs[s].data());
+                }
 
-            {
-                // build BLAS
-                const auto settings = Buffer::BufferSettings{.m_sizeBytes = static_cast<uint32_t>(sizeof(vk::AabbPositionsKHR) * blasAABBs.size()),
-                                                             .m_bufferUsages = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress,
-                                                             .m_memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal,
-                                                             .m_memoryAllocateFlagBits = vk::MemoryAllocateFlagBits::eDeviceAddress,
-                                                             .m_name = "BLASAABBBuffer"};
-                const auto blasAABBBuffer = Buffer::fillDeviceWithStagingBuffer(gpuContext, settings, blasAABBs.data());
-                m_blas = std::make_shared<AabbBLAS>(gpuContext, blasAABBBuffer->getDeviceAddress(), sizeof(vk::AabbPositionsKHR), blasAABBs.size());
-                m_blas->build();
-                blasAABBBuffer->release();
-            }
+                {
+                    // build BLAS
+                    const auto settings = Buffer::BufferSettings{.m_sizeBytes = sizeof(vk::AabbPositionsKHR) * blasAABBs[s].size(),
+                                                                 .m_bufferUsages = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+                                                                 .m_memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal,
+                                                                 .m_memoryAllocateFlagBits = vk::MemoryAllocateFlagBits::eDeviceAddress,
+                                                                 .m_name = "BLASAABBBuffer"};
+                    const auto blasAABBBuffer = Buffer::fillDeviceWithStagingBuffer(gpuContext, settings, blasAABBs[s].data());
+                    segment.m_blas = std::make_shared<AabbBLAS>(gpuContext, blasAABBBuffer->getDeviceAddress(), sizeof(vk::AabbPositionsKHR), blasAABBs[s].size());
+                    segment.m_blas->build();
+                    blasAABBBuffer->release();
+                }
 
-            m_aabbBufferAddress = m_aabbBuffer->getDeviceAddress();
+                segment.m_aabbBufferAddress = segment.m_aabbBuffer->getDeviceAddress();
+            }
         }
 
-        [[nodiscard]] std::optional<ObjectDescriptor> createObjectDescriptor() const {
-            if (!m_aabbBuffer) {
-                constexpr std::optional<ObjectDescriptor> objectDescriptor;
-                return objectDescriptor;
+        // one object descriptor per segment with AABBs, in the order of createBLASHandles, volumeId maps them back to the volume
+        [[nodiscard]] std::vector<ObjectDescriptor> createObjectDescriptors(const uint32_t volumeId) const {
+            std::vector<ObjectDescriptor> objectDescriptors;
+            for (const auto &segment: m_segments) {
+                if (segment.m_aabbBuffer) {
+                    objectDescriptors.push_back({.aabbAddress = segment.m_aabbBufferAddress, .lodAddress = segment.m_lodBufferAddress, .lodAnchorMask = m_gridAligned ? ~15 : -1, .volumeId = volumeId});
+                }
             }
-            auto objectDescriptor = std::make_optional<ObjectDescriptor>();
-            objectDescriptor.value().aabbAddress = m_aabbBufferAddress;
-            objectDescriptor.value().lodAddress = m_lodBufferAddress;
-            return objectDescriptor;
+            return objectDescriptors;
         }
 
-        std::optional<TLAS::BLASHandle> createBLASHandle(uint32_t &instanceCount) const {
-            if (m_blas) {
-                auto handle = std::make_optional<TLAS::BLASHandle>();
-                handle.value().m_blas = m_blas;
-                handle.value().m_instanceCustomIndex = instanceCount;
-                handle.value().m_transform = std::array<std::array<float, 4>, 3>{m_scale.x, 0.0f, 0.0f, m_translate.x, 0.0f, m_scale.y, 0.0f, m_translate.y, 0.0f, 0.0f, m_scale.z, m_translate.z};
+        // one instance per segment with AABBs, the instance custom index selects the object descriptor (i.e. the LOD buffer) of the segment
+        std::vector<TLAS::BLASHandle> createBLASHandles(uint32_t &instanceCount) const {
+            std::vector<TLAS::BLASHandle> handles;
+            for (const auto &segment: m_segments) {
+                if (!segment.m_blas) {
+                    continue;
+                }
+                TLAS::BLASHandle handle;
+                handle.m_blas = segment.m_blas;
+                handle.m_instanceCustomIndex = instanceCount;
+                handle.m_transform = std::array<std::array<float, 4>, 3>{m_scale.x, 0.0f, 0.0f, m_translate.x, 0.0f, m_scale.y, 0.0f, m_translate.y, 0.0f, 0.0f, m_scale.z, m_translate.z};
+                handles.push_back(handle);
                 instanceCount++;
-                return handle;
             }
-            std::optional<TLAS::BLASHandle> handle;
-            return handle;
+            return handles;
         }
 
         void recordHierarchyGUI(const std::function<void()> &rebuildTLASFunction, bool *updateTLAS) {
-            if (ImGui::TreeNodeEx(m_name.c_str(), ImGuiTreeNodeFlags_DefaultOpen)) {
+            // the segments of a volume are separate instances, but toggled per AABB file of the volume
+            const std::string label = m_segments.size() > 1 ? m_name + " (" + std::to_string(m_segments.size()) + " segments)###" + m_name : m_name;
+            if (ImGui::TreeNodeEx(label.c_str(), ImGuiTreeNodeFlags_DefaultOpen)) {
                 for (const auto &aabb: m_aabbs) {
                     aabb->recordHierarchyGUI(rebuildTLASFunction, updateTLAS);
                 }
@@ -275,28 +302,44 @@ namespace raven {
         [[nodiscard]] size_t getAABBCount() const { return m_aabbs.size(); }
 
         [[nodiscard]] uint64_t getAABBBufferSize() const {
-            if (!m_aabbBuffer) {
-                return 0;
+            uint64_t size = 0;
+            for (const auto &segment: m_segments) {
+                size += segment.m_aabbBuffer ? segment.m_aabbBuffer->getSizeBytes() : 0;
             }
-            return m_aabbBuffer->getSizeBytes();
+            return size;
         }
         [[nodiscard]] uint64_t getBLASSize() const {
-            if (!m_blas) {
-                return 0;
+            uint64_t size = 0;
+            for (const auto &segment: m_segments) {
+                size += segment.m_blas ? segment.m_blas->getSizeBytes() : 0;
             }
-            return m_blas->getSizeBytes();
+            return size;
         }
         [[nodiscard]] uint64_t getLODBufferSize() const {
-            if (!m_lodBuffer) {
-                return 0;
+            uint64_t size = 0;
+            for (const auto &segment: m_segments) {
+                size += segment.m_lodBuffer ? segment.m_lodBuffer->getSizeBytes() : 0;
             }
-            return m_lodBuffer->getSizeBytes();
-            // return m_lodBufferSize;
+            return size;
         }
 
         [[nodiscard]] int32_t getLODType() const { return m_lodType; }
 
     private:
+        /**
+         * A segment holds whole LODs in its own LOD buffer, its AABBs in their own AABB buffer and BLAS, and is a separate instance with its own object descriptor.
+         * A node is addressed by the segment (the instance custom index) and a 32bit offset in the LOD buffer of the segment,
+         * hence the LODs of a volume are not limited to 2^32 nodes in total and a merged SVDAG is never split.
+         */
+        struct Segment {
+            std::shared_ptr<Buffer> m_aabbBuffer;
+            vk::DeviceAddress m_aabbBufferAddress{};
+            std::shared_ptr<AabbBLAS> m_blas;
+
+            std::shared_ptr<Buffer> m_lodBuffer;
+            vk::DeviceAddress m_lodBufferAddress{};
+        };
+
         std::string m_dataPath;
         std::string m_folder;
         std::string m_name;
@@ -308,14 +351,13 @@ namespace raven {
         std::vector<std::shared_ptr<VolumeAABB>> m_aabbs;
         std::map<std::string, std::shared_ptr<VolumeLOD>> m_lods;
         int32_t m_lodType = -1;
+        bool m_gridAligned = false; // see ObjectDescriptor::lodAnchorMask
 
-        std::shared_ptr<Buffer> m_aabbBuffer;
-        vk::DeviceAddress m_aabbBufferAddress{};
-        std::shared_ptr<AabbBLAS> m_blas;
+        std::vector<Segment> m_segments;
 
-        std::shared_ptr<Buffer> m_lodBuffer;
-        vk::DeviceAddress m_lodBufferAddress{};
-        // uint64_t m_lodBufferSize{};
+        [[nodiscard]] std::string segmentName(const uint32_t segment) const {
+            return m_segments.size() > 1 ? m_name + "][" + std::to_string(segment) : m_name;
+        }
 
         static bool vec3FromString(const std::string &str, glm::vec3 *vec) {
             const std::regex rgx("([+-]?[0-9]*[.]?[0-9]+) ([+-]?[0-9]*[.]?[0-9]+) ([+-]?[0-9]*[.]?[0-9]+)");
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Raystructs.h"
+#include "VolumeLOD.h"
 #include "imgui.h"
 
 #include <string>
@@ -59,13 +60,14 @@ namespace raven {
             }
         }
 
-        void recordAABBs(std::vector<VoxelAABB> &aabbs, std::vector<vk::AabbPositionsKHR> &blasAABBs, const uint32_t lodOffset) {
+        // lod relocates the roots into the LOD buffer of its segment, nullptr keeps them
+        void recordAABBs(std::vector<VoxelAABB> &aabbs, std::vector<vk::AabbPositionsKHR> &blasAABBs, const VolumeLOD *lod) {
             if (!m_enabled) {
                 return;
             }
 
             for (const auto &aabb : m_aabbs) {
-                aabbs.push_back({.minX = aabb.minX, .minY = aabb.minY, .minZ = aabb.minZ, .maxX = aabb.maxX, .maxY = aabb.maxY, .maxZ = aabb.maxZ, .labelId = aabb.labelId, .lod = aabb.lod + lodOffset});
+                aabbs.push_back({.minX = aabb.minX, .minY = aabb.minY, .minZ = aabb.minZ, .maxX = aabb.maxX, .maxY = aabb.maxY, .maxZ = aabb.maxZ, .labelId = aabb.labelId, .lod = lod ? lod->relocateRoot(aabb.lod) : aabb.lod});
                 blasAABBs.push_back(aabb.toVkAABBPosition());
             }
         }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Raystructs.h"
+#include "../converter/builder/DAGCompact.h"
 
 #include <string>
 
@@ -9,6 +10,8 @@ namespace raven {
         LOD_TYPE_SVO = 0,
         LOD_TYPE_SVDAG = 1,
         LOD_TYPE_SVDAG_OCCUPANCY_FIELD = 2,
+        LOD_TYPE_SVDAG_COMPACT = 3,                 // DAGCompact
+        LOD_TYPE_SVDAG_OCCUPANCY_FIELD_COMPACT = 4, // DAGCompact
     };
 
     class VolumeLOD {
@@ -28,6 +31,10 @@ namespace raven {
                 lodType = LOD_TYPE_SVDAG;
             } else if (type == "svdag_occupancy_field") {
                 lodType = LOD_TYPE_SVDAG_OCCUPANCY_FIELD;
+            } else if (type == "svdag_compact") {
+                lodType = LOD_TYPE_SVDAG_COMPACT;
+            } else if (type == "svdag_occupancy_field_compact") {
+                lodType = LOD_TYPE_SVDAG_OCCUPANCY_FIELD_COMPACT;
             } else {
                 std::cout << name << ": Unknown LOD type " << type << "." << std::endl;
                 return nullptr;
@@ -44,11 +51,12 @@ namespace raven {
             const uint64_t bytesLOD = std::filesystem::file_size(m_dataPath + "/" + m_folder + "/lod/" + m_name + ".bin");
             std::ifstream(m_dataPath + "/" + m_folder + "/lod/" + m_name + ".bin", std::ios::binary).read(lodRaw.data() + m_lodOffset, static_cast<std::streamsize>(bytesLOD));
 
+            // the child pointers are relative to the LOD buffer of the segment
             if ((m_type == LOD_TYPE_SVDAG || m_type == LOD_TYPE_SVDAG_OCCUPANCY_FIELD) && m_lodOffset > 0) {
-                const uint32_t offset = m_lodOffset / getSizeofLOD();
-                const uint32_t numLODs = bytesLOD / getSizeofLOD();
+                const auto offset = static_cast<uint32_t>(m_lodOffset / getSizeofLOD());
+                const uint64_t numLODs = bytesLOD / getSizeofLOD();
                 auto *lod = reinterpret_cast<SVDAG *>(lodRaw.data() + m_lodOffset);
-                for (uint32_t i = 0; i < numLODs; i++) {
+                for (uint64_t i = 0; i < numLODs; i++) {
                     if (lod[i].isLeaf()) {
                         continue;
                     }
@@ -62,13 +70,26 @@ namespace raven {
                     lod[i].child7 += offset;
                 }
             }
+            if ((m_type == LOD_TYPE_SVDAG_COMPACT || m_type == LOD_TYPE_SVDAG_OCCUPANCY_FIELD_COMPACT) && m_lodOffset > 0) {
+                DAGCompact::relocate(reinterpret_cast<uint32_t *>(lodRaw.data() + m_lodOffset), bytesLOD / getSizeofLOD(), static_cast<uint32_t>(m_lodOffset / getSizeofLOD()));
+            }
+        }
+
+        // root pointer of an AABB relative to the LOD buffer of the segment, the sentinels (invalid roots, empty compact roots) are not relocated
+        [[nodiscard]] uint32_t relocateRoot(const uint32_t root) const {
+            const auto offset = static_cast<uint32_t>(m_lodOffset / getSizeofLOD()); // fits by construction of the segments
+            if (m_type == LOD_TYPE_SVDAG_COMPACT || m_type == LOD_TYPE_SVDAG_OCCUPANCY_FIELD_COMPACT) {
+                return DAGCompact::relocatePointer(root, offset);
+            }
+            return root == DAG::invalidPointer() ? root : root + offset;
         }
 
         [[nodiscard]] const std::string &getKey() const { return m_key; }
         [[nodiscard]] const std::string &getName() const { return m_name; }
         [[nodiscard]] VolumeLODType getType() const { return m_type; }
         [[nodiscard]] const std::string &getFolder() const { return m_folder; }
-        [[nodiscard]] uint64_t getLODOffset() const { return m_lodOffset; }
+        [[nodiscard]] uint32_t getSegment() const { return m_segment; }
+        [[nodiscard]] uint64_t getLODOffset() const { return m_lodOffset; } // in bytes, relative to the LOD buffer of the segment
         [[nodiscard]] uint64_t getSizeofLOD() const {
             switch (m_type) {
                 case LOD_TYPE_SVO:
@@ -76,10 +97,19 @@ namespace raven {
                 case LOD_TYPE_SVDAG:
                 case LOD_TYPE_SVDAG_OCCUPANCY_FIELD:
                     return 32;
+                case LOD_TYPE_SVDAG_COMPACT:
+                case LOD_TYPE_SVDAG_OCCUPANCY_FIELD_COMPACT:
+                    return 4; // word
             }
             throw std::runtime_error("Unknown LOD type.");
         }
 
+        // LODs per segment that the pointers of the type address (SVDAG: 32bit, 0xFFFFFFFF is the invalid pointer, DAGCompact: 31bit word offsets)
+        [[nodiscard]] uint64_t getMaxSegmentLODs() const {
+            return m_type == LOD_TYPE_SVDAG_COMPACT || m_type == LOD_TYPE_SVDAG_OCCUPANCY_FIELD_COMPACT ? DAGCompact::MAX_WORDS : 0xFFFFFFFF;
+        }
+
+        void setSegment(const uint32_t segment) { m_segment = segment; }
         void setLODOffset(const uint64_t offset) { m_lodOffset = offset; }
 
     private:
@@ -90,6 +120,7 @@ namespace raven {
         std::string m_key;
         VolumeLODType m_type;
 
+        uint32_t m_segment = 0;
         uint64_t m_lodOffset = 0;
     };
 } // namespace raven
\ No newline at end of file
@@ -165,6 +165,23 @@ namespace raven {
 
                 std::cout << "t=" << t << ", position=(" << position.x << ", " << position.y << ", " << position.z << ")" << std::endl;
             }
+
+            // grid aligned anchor: the AABB is tight, the root is anchored at the cell of the 16^3 lattice that contains it (minimum & ~15)
+            std::cout << "grid anchor test" << std::endl;
+
+            {
+                glm::vec3 origin(0, 1, 0.5);
+                glm::vec3 direction(16, 6, 0);
+                direction = glm::normalize(direction);
+                origin = origin - direction;
+                origin += glm::vec3(16);
+
+                const glm::ivec3 minAABB(20, 17, 16);
+                float t = dagTraversal.traverse(origin, direction, glm::vec3(minAABB), glm::vec3(32), minAABB & ~15);
+                glm::vec3 position = origin + t * direction;
+
+                std::cout << "t=" << t << ", position=(" << position.x << ", " << position.y << ", " << position.z << ")" << std::endl;
+            }
         }
 
         constexpr static uint32_t invalidPointer() { return 0xFFFFFFFF; }
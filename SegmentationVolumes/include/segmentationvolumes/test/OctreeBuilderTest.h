@@ -0,0 +1,112 @@
+#pragma once
+
+#include "../converter/builder/Octree.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <iostream>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace raven {
+    /**
+     * Checks that the bitmask builder (buildBitmaskOctree, from voxels and from a BrickMask) produces the same octrees as the partition builder (buildCellOctree)
+     * on empty, solid, single-voxel and random 16^3 bricks. Throws on the first brick that differs.
+     */
+    class OctreeBuilderTest {
+    public:
+        static void test() {
+            std::mt19937 random(42);
+            std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+            // empty and solid brick
+            testBricks("empty", std::vector<std::vector<Octree::Voxel>>(1), {glm::ivec3(0)});
+            {
+                std::vector<Octree::Voxel> solid;
+                for (uint32_t bit = 0; bit < 16 * 16 * 16; bit++) {
+                    solid.push_back(glm::ivec3(32, -16, 48) + Octree::brickMaskVoxel(bit));
+                }
+                testBricks("solid", {solid}, {glm::ivec3(32, -16, 48)});
+            }
+
+            // every single voxel of the brick, anchored at the origin and off the 16^3 lattice
+            for (const auto &anchor: {glm::ivec3(0), glm::ivec3(-37, 5, 1001)}) {
+                std::vector<std::vector<Octree::Voxel>> bricks;
+                for (int32_t z = 0; z < 16; z++) {
+                    for (int32_t y = 0; y < 16; y++) {
+                        for (int32_t x = 0; x < 16; x++) {
+                            bricks.push_back({anchor + glm::ivec3(x, y, z)});
+                        }
+                    }
+                }
+                testBricks("single voxel", bricks, std::vector<glm::ivec3>(bricks.size(), anchor));
+            }
+
+            // random bricks, sparse and almost solid, the voxels in random order (dense noise exceeds the 12bit child pointers of OctreeNode)
+            for (const float density: {0.001f, 0.01f, 0.1f, 0.99f, 0.999f}) {
+                std::vector<std::vector<Octree::Voxel>> bricks(256);
+                std::vector<glm::ivec3> anchors(bricks.size());
+                for (uint32_t b = 0; b < bricks.size(); b++) {
+                    anchors[b] = glm::ivec3(static_cast<int32_t>(b) * 16 - 2048, static_cast<int32_t>(b % 7) - 3, 0);
+                    for (uint32_t bit = 0; bit < 16 * 16 * 16; bit++) {
+                        if (uniform(random) < density) {
+                            bricks[b].push_back(anchors[b] + Octree::brickMaskVoxel(bit));
+                        }
+                    }
+                    std::shuffle(bricks[b].begin(), bricks[b].end(), random);
+                }
+                testBricks("random " + std::to_string(density), bricks, anchors);
+            }
+        }
+
+    private:
+        static void testBricks(const std::string &name, const std::vector<std::vector<Octree::Voxel>> &bricks, const std::vector<glm::ivec3> &anchors) {
+            std::vector<Octree::BrickMask> masks(bricks.size(), Octree::BrickMask{});
+            for (uint32_t b = 0; b < bricks.size(); b++) {
+                for (const auto &voxel: bricks[b]) {
+                    const uint32_t bit = Octree::brickMaskBit(voxel - anchors[b]);
+                    masks[b].words[bit >> 6] |= UINT64_C(1) << (bit & 63);
+                }
+            }
+
+            const auto build = [&](const Octree::Builder builder, const bool fromMask) {
+                std::vector<std::vector<Octree::Voxel>> voxels = bricks; // the partition builder reorders the voxels
+                std::vector<Octree::OctreeBuildInfo> octreeBuildInfos(bricks.size());
+                for (uint32_t b = 0; b < bricks.size(); b++) {
+                    octreeBuildInfos[b].labelId = b;
+                    octreeBuildInfos[b].anchor = anchors[b];
+                    octreeBuildInfos[b].voxels = std::span(voxels[b]);
+                    octreeBuildInfos[b].mask = fromMask ? &masks[b] : nullptr;
+                }
+                Octree octree(builder);
+                octree.buildOctrees(octreeBuildInfos);
+                return octree;
+            };
+
+            const Octree reference = build(Octree::BUILDER_PARTITION, false);
+            for (const bool fromMask: {false, true}) {
+                const Octree octree = build(Octree::BUILDER_BITMASK, fromMask);
+                const auto octreeNodes = [](const Octree &o, const uint32_t b) {
+                    const uint32_t end = b + 1 < o.m_octreeIndices.size() ? o.m_octreeIndices[b + 1] : static_cast<uint32_t>(o.m_octrees.size());
+                    return std::span(o.m_octrees).subspan(o.m_octreeIndices[b], end - o.m_octreeIndices[b]);
+                };
+                for (uint32_t b = 0; b < bricks.size(); b++) {
+                    const auto referenceNodes = octreeNodes(reference, b);
+                    const auto nodes = octreeNodes(octree, b);
+                    if (!std::equal(referenceNodes.begin(), referenceNodes.end(), nodes.begin(), nodes.end())) {
+                        throw std::runtime_error("OctreeBuilderTest: Bitmask octree " + std::string(fromMask ? "(mask) " : "") + "differs from partition octree (" + name + ", brick " + std::to_string(b) + ").");
+                    }
+                }
+                if (octree.m_octrees.size() != reference.m_octrees.size()) {
+                    throw std::runtime_error("OctreeBuilderTest: Bitmask octrees differ in size from partition octrees (" + name + ").");
+                }
+            }
+
+            std::cout << "[OctreeBuilderTest] " << name << ": " << bricks.size() << " bricks, " << reference.m_octrees.size() << " nodes, equal." << std::endl;
+        }
+    };
+} // namespace raven
@@ -4,5 +4,7 @@
 #define LOD_TYPE_SVO 0
 #define LOD_TYPE_SVDAG 1
 #define LOD_TYPE_SVDAG_OCCUPANCY_FIELD 2
+#define LOD_TYPE_SVDAG_COMPACT 3
+#define LOD_TYPE_SVDAG_OCCUPANCY_FIELD_COMPACT 4
 
 #endif
\ No newline at end of file
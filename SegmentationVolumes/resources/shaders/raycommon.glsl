@@ -2,7 +2,7 @@
 #define RAYCOMMON_GLSL
 
 struct HitPayload {
-    int objectDescriptorId; // gl_InstanceCustomIndexEXT
+    int objectDescriptorId; // gl_InstanceCustomIndexEXT, i.e. a segment of a volume (see ObjectDescriptor.volumeId)
     int primitiveId; // gl_PrimitiveID
     float t; // distance
 };
@@ -4,6 +4,8 @@
 struct ObjectDescriptor {
     uint64_t aabbAddress; // address to the buffer that contains all AABBs of the object, each object can have its own buffer, but a large shared buffer is possible as well
     uint64_t lodAddress; // address to the buffer that contains all LOD information of the section
+    int lodAnchorMask; // the root of the LOD of an AABB is anchored at the minimum of the AABB & lodAnchorMask, ~15 if the octrees are aligned to the global 16^3 lattice
+    uint volumeId; // index of the volume in the scene, a volume has one object descriptor per segment (see Volume::createObjectDescriptors)
 };
 
 struct AABB {
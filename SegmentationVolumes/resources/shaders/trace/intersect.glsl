@@ -14,6 +14,11 @@ float intersect_minDistancePointBox(in const vec3 p, in const vec3 bmin, in cons
     return length(d);
 }
 
+// minimum corner of the 16^3 root of the LOD of the AABB, the minimum of the AABB or its cell of the global 16^3 lattice (see ObjectDescriptor)
+vec3 intersect_lodAnchor(in const ObjectDescriptor objectDescriptor, in const AABB aabb) {
+    return vec3(ivec3(aabb.minX, aabb.minY, aabb.minZ) & objectDescriptor.lodAnchorMask);
+}
+
 float hitSphere(const vec3 sphereCenter, const float sphereRadius, const vec3 rayOrigin, const vec3 rayDirection) {
     vec3  oc           = rayOrigin - sphereCenter;
     float a            = dot(rayDirection, rayDirection);
@@ -47,7 +52,7 @@ bool intersect(in const int objectDescriptorId, in const int primitiveId, in vec
         return tHit >= 0;
     }
 
-    if (g_lodType == LOD_TYPE_SVDAG_OCCUPANCY_FIELD) {
+    if (g_lodType == LOD_TYPE_SVDAG_OCCUPANCY_FIELD || g_lodType == LOD_TYPE_SVDAG_OCCUPANCY_FIELD_COMPACT) {
         const vec3 aabbMin = vec3(aabb.minX, aabb.minY, aabb.minZ);
         const vec3 aabbMax = vec3(aabb.maxX, aabb.maxY, aabb.maxZ);
         const vec3 aabbMinWorld = objectToWorld * vec4(aabbMin.xyz, 1.0);
@@ -71,7 +76,7 @@ bool intersect(in const int objectDescriptorId, in const int primitiveId, in vec
 
             int iterations;
             origin = origin + tHit * direction;
-            origin = origin - aabbMin;// translate lod to (0,0,0), LOD is then in [(0,0,0), lodSize]
+            origin = origin - intersect_lodAnchor(objectDescriptor, aabb);// translate lod to (0,0,0), LOD is then in [(0,0,0), lodSize]
             tHit += svdag_occupancy_field_traverse(objectDescriptor.lodAddress, origin, direction, aabb.lod, traverseOccupancyFields, iterations);
 
             if (tHit >= FLT_MAX) {
@@ -83,7 +88,7 @@ bool intersect(in const int objectDescriptorId, in const int primitiveId, in vec
         return false;
     }
 
-    if (g_lodType == LOD_TYPE_SVDAG) {
+    if (g_lodType == LOD_TYPE_SVDAG || g_lodType == LOD_TYPE_SVDAG_COMPACT) {
         const vec3 aabbMin = vec3(aabb.minX, aabb.minY, aabb.minZ);
         const vec3 aabbMax = vec3(aabb.maxX, aabb.maxY, aabb.maxZ);
         const vec3 aabbMinWorld = objectToWorld * vec4(aabbMin.xyz, 1.0);
@@ -105,7 +110,7 @@ bool intersect(in const int objectDescriptorId, in const int primitiveId, in vec
 
             int iterations;
             origin = origin + tHit * direction;
-            origin = origin - aabbMin;// translate lod to (0,0,0), LOD is then in [(0,0,0), lodSize]
+            origin = origin - intersect_lodAnchor(objectDescriptor, aabb);// translate lod to (0,0,0), LOD is then in [(0,0,0), lodSize]
             tHit += svdag_traverse(objectDescriptor.lodAddress, origin, direction, aabb.lod, iterations);
 
             if (tHit >= FLT_MAX) {
@@ -134,7 +139,7 @@ bool intersect(in const int objectDescriptorId, in const int primitiveId, in vec
         }
 
         int iterations;
-        tHit = svo_traverse(objectDescriptor.lodAddress, origin, direction, 1 / direction, aabb.lod, ivec3(aabb.minX, aabb.minY, aabb.minZ), iterations);
+        tHit = svo_traverse(objectDescriptor.lodAddress, origin, direction, 1 / direction, aabb.lod, ivec3(intersect_lodAnchor(objectDescriptor, aabb)), iterations);
         if (tHit >= FLT_MAX) {
             return false;
         }
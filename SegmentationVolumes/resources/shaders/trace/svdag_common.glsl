@@ -4,7 +4,36 @@
 #define LOD_LEVELS 4
 #define LOD_INVALID_POINTER 0xFFFFFFFF
 
+#define LOD_COMPACT_LEAF_FLAG 0x100
+#define LOD_COMPACT_LEAF_POINTER 0x80000000
+#define LOD_COMPACT_EMPTY_CHILD 0x7FFFFFFF // must differ from LOD_INVALID_POINTER, which marks the decoded node as leaf
+
+// variable-size node of DAGCompact: [ child mask | pointers of the set children ] or [ leaf flag | child1 | child2 ], or a 64bit field of the leaf table, decoded into an SVDAG node
+SVDAG svdag_fetchCompactNode(in const uint64_t lodAddress, in const uint index) {
+    if (index == LOD_COMPACT_EMPTY_CHILD) {
+        return SVDAG(LOD_INVALID_POINTER, 0, 0, LOD_INVALID_POINTER, LOD_INVALID_POINTER, LOD_INVALID_POINTER, LOD_INVALID_POINTER, LOD_INVALID_POINTER);
+    }
+    if ((index & LOD_COMPACT_LEAF_POINTER) != 0) {
+        // field of the leaf table, lower word first
+        buffer_svdag_compact field = buffer_svdag_compact(lodAddress + uint64_t(4) * uint64_t(index & ~LOD_COMPACT_LEAF_POINTER));
+        return SVDAG(LOD_INVALID_POINTER, field.g_words[1], field.g_words[0], LOD_INVALID_POINTER, LOD_INVALID_POINTER, LOD_INVALID_POINTER, LOD_INVALID_POINTER, LOD_INVALID_POINTER);
+    }
+    buffer_svdag_compact words = buffer_svdag_compact(lodAddress + uint64_t(4) * uint64_t(index));
+    const uint header = words.g_words[0];
+    if ((header & LOD_COMPACT_LEAF_FLAG) != 0) {
+        return SVDAG(LOD_INVALID_POINTER, words.g_words[1], words.g_words[2], LOD_INVALID_POINTER, LOD_INVALID_POINTER, LOD_INVALID_POINTER, LOD_INVALID_POINTER, LOD_INVALID_POINTER);
+    }
+    uint children[8];
+    for (uint c = 0; c < 8; c++) {
+        children[c] = (header & (1u << c)) != 0 ? words.g_words[1 + bitCount(header & ((1u << c) - 1u))] : LOD_COMPACT_EMPTY_CHILD;
+    }
+    return SVDAG(children[0], children[1], children[2], children[3], children[4], children[5], children[6], children[7]);
+}
+
 SVDAG svdag_fetchNode(in const uint64_t lodAddress, in const uint index) {
+    if (g_lodType == LOD_TYPE_SVDAG_COMPACT || g_lodType == LOD_TYPE_SVDAG_OCCUPANCY_FIELD_COMPACT) {
+        return svdag_fetchCompactNode(lodAddress, index);
+    }
     // https://github.com/KhronosGroup/Vulkan-Docs/issues/1016
     // https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkDescriptorBufferInfo.html
     // https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkPhysicalDeviceLimits.html
@@ -13,8 +13,11 @@
 #include "segmentationvolumes/converter/CellsConverter.h"
 #include "segmentationvolumes/converter/MouseConverter.h"
 #include "segmentationvolumes/converter/builder/DAGGPUTest.h"
+#include "segmentationvolumes/converter/builder/DAGReduceBenchmark.h"
+#include "segmentationvolumes/converter/builder/OctreeBenchmark.h"
 #include "segmentationvolumes/evaluation/SegmentationVolumesEvaluation.h"
 #include "segmentationvolumes/test/DAGTraversalTest.h"
+#include "segmentationvolumes/test/OctreeBuilderTest.h"
 
 int main(int argc, char *argv[]) {
 #ifdef RESOURCE_DIRECTORY_PATH
@@ -42,6 +45,63 @@ int main(int argc, char *argv[]) {
     program.add_argument("--convert")
             .help("perform conversion from raw data to compressed format")
             .flag();
+    program.add_argument("--threads")
+            .help("number of labels converted concurrently (default: number of hardware threads)")
+            .scan<'u', uint32_t>();
+    program.add_argument("--memory-budget")
+            .help("memory budget in GiB for the labels converted concurrently")
+            .default_value(16.0)
+            .scan<'g', double>();
+    program.add_argument("--sorted")
+            .help("store SVDAG levels in lexicographic order, such that the labels are merged with a streaming k-way merge")
+            .flag();
+    program.add_argument("--external-merge")
+            .help("merge the labels out-of-core with the given memory cap in GiB (0: merge in memory)")
+            .default_value(0.0)
+            .scan<'g', double>();
+    program.add_argument("--hash-consing")
+            .help("deduplicate SVDAG nodes while traversing the octrees instead of reducing the full SVDAG afterwards")
+            .flag();
+    program.add_argument("--fused")
+            .help("build the SVDAGs directly from the voxels without writing the intermediate SVO files")
+            .flag();
+    program.add_argument("--keep-svo")
+            .help("with --fused, write the SVO files as well (required to render with the SVO LOD type)")
+            .flag();
+    program.add_argument("--bitmask-octrees")
+            .help("build the 16^3 octrees from occupancy bitmasks instead of partitioning the voxels")
+            .flag();
+    program.add_argument("--sharded-voxels")
+            .help("write the voxels of all labels into a single indexed container instead of one file per label")
+            .flag();
+    program.add_argument("--chunk-voxels")
+            .help("voxels of a label that are expanded and subdivided at once, larger labels are processed in chunks of whole 16^3 bricks")
+            .scan<'u', uint64_t>();
+    program.add_argument("--merge-segment-nodes")
+            .help("maximum number of nodes of a merged SVDAG, the labels are merged in consecutive segments that are rendered from separate LOD buffers")
+            .scan<'u', uint64_t>();
+    program.add_argument("--reduce-benchmark")
+            .help("compare the SVDAG reduce modes (hash comparator, radix sort, lexicographic) on the combined SVDAGs of the labels instead of merging them (with --convert)")
+            .flag();
+    program.add_argument("--append")
+            .help("append the given labels (e.g. neuron241) to the existing merged SVDAG instead of merging all labels again")
+            .nargs(argparse::nargs_pattern::at_least_one);
+    program.add_argument("--append-reserve")
+            .help("fraction of free node slots reserved in every level of the merged SVDAG, such that --append does not shift the levels")
+            .default_value(0.0)
+            .scan<'g', double>();
+    program.add_argument("--compact")
+            .help("additionally encode the SVDAGs with variable-size child mask nodes (<svdag>_compact, <svdag>_merged_compact)")
+            .flag();
+    program.add_argument("--leaf-table")
+            .help("with --compact, store the leaves as deduplicated 64bit fields in a table instead of as nodes")
+            .flag();
+    program.add_argument("--octree-benchmark")
+            .help("check that the bitmask octree builder matches the partition builder and benchmark both on synthetic 16^3 bricks, then exit")
+            .flag();
+    program.add_argument("--subdivision")
+            .help("subdivision of the labels into 16^3 octrees: median (recursive median splits), morton (16^3 cells of the label AABB) or grid (global 16^3 lattice)")
+            .default_value(std::string("median"));
 
     try {
         program.parse_args(argc, argv);
@@ -51,6 +111,12 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    if (program["--octree-benchmark"] == true) {
+        raven::OctreeBuilderTest::test();
+        raven::OctreeBenchmark::benchmark();
+        return EXIT_SUCCESS;
+    }
+
     auto rendererSettings = raven::SegmentationVolumes::SegmentationVolumesSettings{
             .m_data = program.get("data"),
             .m_scene = program.get("scene"),
@@ -65,15 +131,83 @@ int main(int argc, char *argv[]) {
     }
 
     if (program["--convert"] == true) {
+        const auto configureConverter = [&program](raven::SegmentationVolumeConverter &converter) {
+            if (const auto threads = program.present<uint32_t>("--threads")) {
+                converter.setNumThreads(threads.value());
+            }
+            converter.setMemoryBudget(static_cast<uint64_t>(program.get<double>("--memory-budget") * static_cast<double>(1ull << 30)));
+            converter.setExternalMergeMemoryCap(static_cast<uint64_t>(program.get<double>("--external-merge") * static_cast<double>(1ull << 30)));
+            if (const auto mergeSegmentNodes = program.present<uint64_t>("--merge-segment-nodes")) {
+                converter.setMergeSegmentNodes(mergeSegmentNodes.value());
+            }
+            if (const auto chunkVoxels = program.present<uint64_t>("--chunk-voxels")) {
+                converter.setChunkVoxels(chunkVoxels.value());
+            }
+            if (program["--sorted"] == true) {
+                converter.setReduceMode(raven::DAG::REDUCE_MODE_LEXICOGRAPHIC);
+            }
+            if (program["--hash-consing"] == true) {
+                converter.setDAGBuilder(raven::SegmentationVolumeConverter::DAG_BUILDER_HASH_CONSING);
+            }
+            if (program["--bitmask-octrees"] == true) {
+                converter.setOctreeBuilder(raven::Octree::BUILDER_BITMASK);
+            }
+            if (program["--sharded-voxels"] == true) {
+                converter.setVoxelLayout(raven::VoxelWriter::LAYOUT_SHARDED);
+            }
+            converter.setCompactLeafTable(program["--leaf-table"] == true);
+            converter.setAppendReserve(program.get<double>("--append-reserve"));
+            if (program.get("--subdivision") == "morton") {
+                converter.setSubdivision(raven::SegmentationVolumeConverter::SUBDIVISION_MORTON_BUCKETS);
+            } else if (program.get("--subdivision") == "grid") {
+                converter.setSubdivision(raven::SegmentationVolumeConverter::SUBDIVISION_GRID_ALIGNED);
+            } else if (program.get("--subdivision") != "median") {
+                throw std::runtime_error("Unknown subdivision " + program.get("--subdivision") + ".");
+            }
+        };
+
+        const auto voxelTypesToAABBsAndDAGs = [&program](const raven::SegmentationVolumeConverter &converter) {
+            if (program["--fused"] == true) {
+                converter.voxelTypesToAABBsAndDAGs(program["--keep-svo"] == true);
+                return;
+            }
+            converter.voxelTypesToAABBsAndOctrees();
+            converter.AABBsAndOctreesToAABBsAndDAGs();
+        };
+
+        const auto mergeDAGs = [&program](const raven::SegmentationVolumeConverter &converter, const std::vector<raven::SegmentationVolumeConverter::DAGFileInfo> &dagFileInfos) {
+            if (program["--reduce-benchmark"] == true) {
+                raven::DAGReduceBenchmark::benchmark(program.get("data"), program.get("scene"), converter.mergeSegments(dagFileInfos));
+                return;
+            }
+            if (const auto append = program.present<std::vector<std::string>>("--append")) {
+                std::vector<raven::SegmentationVolumeConverter::DAGFileInfo> appendFileInfos;
+                for (const auto &label: append.value()) {
+                    const auto it = std::find_if(dagFileInfos.begin(), dagFileInfos.end(), [&label](const auto &dagFileInfo) { return dagFileInfo.m_lod == label; });
+                    if (it == dagFileInfos.end()) {
+                        throw std::runtime_error("Label " + label + " to append does not exist.");
+                    }
+                    appendFileInfos.push_back(*it);
+                }
+                converter.appendDAGs(appendFileInfos);
+            } else {
+                converter.mergeDAGs(dagFileInfos);
+            }
+            // the merged SVDAG holds all labels, also after appending
+            if (program["--compact"] == true) {
+                converter.compactDAGs(dagFileInfos);
+            }
+        };
+
         if (program.get("scene") == "cells") {
             const std::string data = program.get("data");
             const std::string scene = "cells";
             raven::CellsConverter converter(data, scene, true);
+            configureConverter(converter);
             // converter.nodeInfo();
             // converter.nodeDegree();
             converter.rawDataToVoxelTypes();
-            converter.voxelTypesToAABBsAndOctrees();
-            converter.AABBsAndOctreesToAABBsAndDAGs();
+            voxelTypesToAABBsAndDAGs(converter);
             std::vector<raven::SegmentationVolumeConverter::DAGFileInfo> dagFileInfos;
             for (uint32_t i = 1; i <= 27; i++) {
                 const std::string str = "type" + std::to_string(i);
@@ -84,17 +218,17 @@ int main(int argc, char *argv[]) {
                 }
                 dagFileInfos.push_back(dagFileInfo);
             }
-            converter.mergeDAGs(dagFileInfos);
-            // raven::DAGGPUTest::test(data, scene, dagFileInfos, "types", converter.stringSVDAG(true));
+            mergeDAGs(converter, dagFileInfos);
+            // raven::DAGGPUTest::test(data, scene, converter.mergeSegments(dagFileInfos), "types", converter.stringSVDAG(true));
             return 0;
         }
         if (program.get("scene") == "celegans") {
             const std::string data = program.get("data");
             const std::string scene = "celegans";
             raven::CElegansConverter converter(data, scene, true);
+            configureConverter(converter);
             // converter.nodeInfo();
-            converter.voxelTypesToAABBsAndOctrees();
-            converter.AABBsAndOctreesToAABBsAndDAGs();
+            voxelTypesToAABBsAndDAGs(converter);
             std::vector<raven::SegmentationVolumeConverter::DAGFileInfo> dagFileInfos;
             for (uint32_t i = 1; i <= 240; i++) {
                 const std::string str = "neuron" + std::to_string(i);
@@ -105,19 +239,19 @@ int main(int argc, char *argv[]) {
                 }
                 dagFileInfos.push_back(dagFileInfo);
             }
-            converter.mergeDAGs(dagFileInfos);
-            // raven::DAGGPUTest::test(data, scene, dagFileInfos, "neurons", converter.stringSVDAG(true));
+            mergeDAGs(converter, dagFileInfos);
+            // raven::DAGGPUTest::test(data, scene, converter.mergeSegments(dagFileInfos), "neurons", converter.stringSVDAG(true));
             return 0;
         }
         if (program.get("scene") == "mouse") {
             const std::string data = program.get("data");
             const std::string scene = "mouse";
             raven::MouseConverter converter(data, scene, true);
+            configureConverter(converter);
             // converter.nodeInfo();
             // converter.nodeDegree();
             converter.rawDataToVoxelTypes();
-            converter.voxelTypesToAABBsAndOctrees();
-            converter.AABBsAndOctreesToAABBsAndDAGs();
+            voxelTypesToAABBsAndDAGs(converter);
             std::vector<raven::SegmentationVolumeConverter::DAGFileInfo> dagFileInfos;
             for (uint32_t i = 1; i <= 96; i++) {
                 const std::string str = "neuron" + std::to_string(i);
@@ -128,7 +262,7 @@ int main(int argc, char *argv[]) {
                 }
                 dagFileInfos.push_back(dagFileInfo);
             }
-            converter.mergeDAGs(dagFileInfos);
+            mergeDAGs(converter, dagFileInfos);
             return 0;
         }
     }